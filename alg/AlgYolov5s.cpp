@@ -18,19 +18,55 @@
 #include <memory>
 #include <algorithm>
 #include <fstream>
+#include <mutex>
 
 #include "TSYolov5s.h"
+#include "TSBatcher.h"
 #include "AlgYolov5s.h"
 
+//
+// algorithm output modes
+//
+typedef enum _OutputMode {
+    OUTPUT_BOXES = 0,   // boxes of every detected object
+    OUTPUT_COUNT,       // object number of each class
+    OUTPUT_DENSITY      // object number of each class and objectness density grid
+} OutputMode;
+
 //
 // algorithm arguments
 //
 typedef struct _AlgConfig {
     std::string       modelPath{ "/opt/thundersoft/algs/model/yolov5s.dlc" };
-    ts::TSRect_T<int> roi { ts::TSRect_T<int>(100, 100, 1720, 880)};
+    ts::TSRect_T<int> roi { ts::TSRect_T<int>(0, 0, 0, 0)};
+    std::vector<ts::TSRect_T<int> > rois{};
     float             nmsThresh{ 0.5 };
     float             confThresh{ 0.5 };
     runtime_t         runtime{ DSP };
+    interp_t          interp{ INTERP_LINEAR };
+    int               minSize{ 5 };
+    int               maxSize{ 0 };
+    int               inputWidth{ 0 };
+    int               inputHeight{ 0 };
+    encoding_t        inputEncoding{ ENCODING_FLOAT };
+    encoding_t        outputEncoding{ ENCODING_FLOAT };
+    OutputMode        outputMode{ OUTPUT_BOXES };
+    int               preThreads{ 1 };
+    int               postThreads{ 1 };
+    bool              classAwareNms{ false };
+    int               topK{ 0 };
+    int               maxDetections{ 0 };
+    bool              bestClassOnly{ false };
+    std::vector<int>  classes{};
+    std::vector<float> classThresh{};
+    std::vector<std::vector<ts::TSPoint> > includeRegions{};
+    std::vector<std::vector<ts::TSPoint> > excludeRegions{};
+    ts::MotionGateParams motion{};
+    ts::TrackerParams tracker{};
+    ts::TilingParams tiling{};
+    ts::FoveaParams fovea{};
+    ts::BatcherParams batcher{};
+    std::map<runtime_t, int> engines{};
     std::string       labelPath{"/opt/thundersoft/configs/yolov5s.txt"};
 } AlgConfig;
 
@@ -40,12 +76,27 @@ typedef struct _AlgConfig {
 typedef struct _AlgCore {
     AlgConfig                cfg_;
     ts::TSObjectDetection*   alg_{ NULL };
+    ts::TSBatcher*           batcher_{ NULL };
+    std::string              args_ {};
     std::vector<std::string> labels_ {};
     TsPutResult              cb_put_result_ { nullptr };
     TsPutResults             cb_put_results_{ nullptr };
     void*                    cb_user_data_  { nullptr };
 } AlgCore;
 
+//
+// AlgShared: detector and batcher of the streams with the same arguments, or the
+// detector owning the engines they share
+//
+typedef struct _AlgShared {
+    ts::TSObjectDetection*   alg_{ NULL };
+    ts::TSBatcher*           batcher_{ NULL };
+    int                      refs_{ 0 };
+} AlgShared;
+
+static std::mutex                         g_sharedMutex;
+static std::map<std::string, AlgShared*>  g_shared;
+
 static runtime_t string2runtime(std::string& device)
 {
     std::transform(device.begin(), device.end(), device.begin(),
@@ -65,6 +116,70 @@ static runtime_t string2runtime(std::string& device)
     }
 }
 
+static interp_t string2interp(std::string& interp)
+{
+    std::transform(interp.begin(), interp.end(), interp.begin(),
+        [](unsigned char ch){ return tolower(ch); }
+    );
+
+    if (0 == interp.compare("nearest")) {
+        return INTERP_NEAREST;
+    } else if (0 == interp.compare("area")) {
+        return INTERP_AREA;
+    } else {
+        return INTERP_LINEAR;
+    }
+}
+
+static encoding_t string2encoding(std::string& encoding)
+{
+    std::transform(encoding.begin(), encoding.end(), encoding.begin(),
+        [](unsigned char ch){ return tolower(ch); }
+    );
+
+    if (0 == encoding.compare("tf8")) {
+        return ENCODING_TF8;
+    } else if (0 == encoding.compare("fp16")) {
+        return ENCODING_FP16;
+    } else {
+        return ENCODING_FLOAT;
+    }
+}
+
+static OutputMode string2mode(std::string& mode)
+{
+    std::transform(mode.begin(), mode.end(), mode.begin(),
+        [](unsigned char ch){ return tolower(ch); }
+    );
+
+    if (0 == mode.compare("count")) {
+        return OUTPUT_COUNT;
+    } else if (0 == mode.compare("density")) {
+        return OUTPUT_DENSITY;
+    } else {
+        return OUTPUT_BOXES;
+    }
+}
+
+static gint string2format(const std::string& format)
+{
+    if (0 == format.compare("RGB")) {
+        return TYPE_RGB_U8;
+    } else if (0 == format.compare("BGR")) {
+        return TYPE_BGR_U8;
+    } else if (0 == format.compare("RGBx")) {
+        return TYPE_RGBX_U8;
+    } else if (0 == format.compare("BGRx")) {
+        return TYPE_BGRX_U8;
+    } else if (0 == format.compare("NV12")) {
+        return TYPE_NV12;
+    } else if (0 == format.compare("I420")) {
+        return TYPE_I420;
+    } else {
+        return TYPE_UNKNOWN;
+    }
+}
+
 static bool parse_args(AlgConfig& config, const std::string& data)
 {
     JsonParser* parser = NULL;
@@ -124,6 +239,329 @@ static bool parse_args(AlgConfig& config, const std::string& data)
                 config.confThresh = (float)c;
             }
 
+            if (json_object_has_member(object, "min-size")) {
+                int s = json_object_get_int_member(object, "min-size");
+                TS_INFO_MSG_V("\tmin-size:%d", s);
+                config.minSize = s;
+            }
+
+            if (json_object_has_member(object, "max-size")) {
+                int s = json_object_get_int_member(object, "max-size");
+                TS_INFO_MSG_V("\tmax-size:%d", s);
+                config.maxSize = s;
+            }
+
+            if (json_object_has_member(object, "input-size")) {
+                JsonObject* s = json_object_get_object_member(object, "input-size");
+
+                if (json_object_has_member(s, "w")) {
+                    int w = json_object_get_int_member(s, "w");
+                    TS_INFO_MSG_V("\tinput-size w:%d", w);
+                    config.inputWidth = w;
+                }
+
+                if (json_object_has_member(s, "h")) {
+                    int h = json_object_get_int_member(s, "h");
+                    TS_INFO_MSG_V("\tinput-size h:%d", h);
+                    config.inputHeight = h;
+                }
+            }
+
+            if (json_object_has_member(object, "input-encoding")) {
+                std::string e((const char*)json_object_get_string_member(
+                    object, "input-encoding"));
+                TS_INFO_MSG_V("\tinput-encoding:%s", e.c_str());
+                config.inputEncoding = string2encoding(e);
+            }
+
+            if (json_object_has_member(object, "output-encoding")) {
+                std::string e((const char*)json_object_get_string_member(
+                    object, "output-encoding"));
+                TS_INFO_MSG_V("\toutput-encoding:%s", e.c_str());
+                config.outputEncoding = string2encoding(e);
+            }
+
+            if (json_object_has_member(object, "output-mode")) {
+                std::string m((const char*)json_object_get_string_member(
+                    object, "output-mode"));
+                TS_INFO_MSG_V("\toutput-mode:%s", m.c_str());
+                config.outputMode = string2mode(m);
+            }
+
+            if (json_object_has_member(object, "interpolation")) {
+                std::string i((const char*)json_object_get_string_member(
+                    object, "interpolation"));
+                TS_INFO_MSG_V("\tinterpolation:%s", i.c_str());
+                config.interp = string2interp(i);
+            }
+
+            if (json_object_has_member(object, "preprocess-threads")) {
+                gint t = json_object_get_int_member(object, "preprocess-threads");
+                TS_INFO_MSG_V("\tpreprocess-threads:%d", t);
+                config.preThreads = t;
+            }
+
+            if (json_object_has_member(object, "postprocess-threads")) {
+                gint t = json_object_get_int_member(object, "postprocess-threads");
+                TS_INFO_MSG_V("\tpostprocess-threads:%d", t);
+                config.postThreads = t;
+            }
+
+            if (json_object_has_member(object, "class-aware-nms")) {
+                gboolean c = json_object_get_boolean_member(object, "class-aware-nms");
+                TS_INFO_MSG_V("\tclass-aware-nms:%s", c ? "true" : "false");
+                config.classAwareNms = c;
+            }
+
+            if (json_object_has_member(object, "top-k")) {
+                gint k = json_object_get_int_member(object, "top-k");
+                TS_INFO_MSG_V("\ttop-k:%d", k);
+                config.topK = k;
+            }
+
+            if (json_object_has_member(object, "max-detections")) {
+                gint m = json_object_get_int_member(object, "max-detections");
+                TS_INFO_MSG_V("\tmax-detections:%d", m);
+                config.maxDetections = m;
+            }
+
+            if (json_object_has_member(object, "best-class-only")) {
+                gboolean b = json_object_get_boolean_member(object, "best-class-only");
+                TS_INFO_MSG_V("\tbest-class-only:%s", b ? "true" : "false");
+                config.bestClassOnly = b;
+            }
+
+            // "classes": [0, {"id":2, "conf-thresh":0.3}, ...]
+            if (json_object_has_member(object, "classes")) {
+                JsonArray* c = json_object_get_array_member(object, "classes");
+
+                for (guint i = 0; i < json_array_get_length(c); i++) {
+                    JsonNode* node = json_array_get_element(c, i);
+                    gint id = -1;
+                    gdouble t = -1.0;
+
+                    if (JSON_NODE_HOLDS_OBJECT(node)) {
+                        JsonObject* o = json_node_get_object(node);
+                        if (json_object_has_member(o, "id")) {
+                            id = json_object_get_int_member(o, "id");
+                        }
+                        if (json_object_has_member(o, "conf-thresh")) {
+                            t = json_object_get_double_member(o, "conf-thresh");
+                        }
+                    } else {
+                        id = json_node_get_int(node);
+                    }
+
+                    TS_INFO_MSG_V("\tclass:%d conf-thresh:%f", id, t);
+                    config.classes.push_back(id);
+                    config.classThresh.push_back((float)t);
+                }
+            }
+
+            if (json_object_has_member(object, "motion-gate")) {
+                JsonObject* m = json_object_get_object_member(object, "motion-gate");
+
+                if (json_object_has_member(m, "max-skip")) {
+                    gint k = json_object_get_int_member(m, "max-skip");
+                    TS_INFO_MSG_V("\tmotion-gate max-skip:%d", k);
+                    config.motion.maxSkip = k;
+                }
+
+                if (json_object_has_member(m, "pixel-thresh")) {
+                    gint t = json_object_get_int_member(m, "pixel-thresh");
+                    TS_INFO_MSG_V("\tmotion-gate pixel-thresh:%d", t);
+                    config.motion.pixelThresh = t;
+                }
+
+                if (json_object_has_member(m, "min-area")) {
+                    gdouble a = json_object_get_double_member(m, "min-area");
+                    TS_INFO_MSG_V("\tmotion-gate min-area:%f", a);
+                    config.motion.minArea = (float)a;
+                }
+
+                if (json_object_has_member(m, "padding")) {
+                    gint p = json_object_get_int_member(m, "padding");
+                    TS_INFO_MSG_V("\tmotion-gate padding:%d", p);
+                    config.motion.padding = p;
+                }
+
+                if (json_object_has_member(m, "max-crop-area")) {
+                    gdouble a = json_object_get_double_member(m, "max-crop-area");
+                    TS_INFO_MSG_V("\tmotion-gate max-crop-area:%f", a);
+                    config.motion.maxCropArea = (float)a;
+                }
+            }
+
+            if (json_object_has_member(object, "tracker")) {
+                JsonObject* t = json_object_get_object_member(object, "tracker");
+
+                if (json_object_has_member(t, "detect-interval")) {
+                    gint i = json_object_get_int_member(t, "detect-interval");
+                    TS_INFO_MSG_V("\ttracker detect-interval:%d", i);
+                    config.tracker.detectInterval = i;
+                }
+
+                if (json_object_has_member(t, "min-confidence")) {
+                    gdouble c = json_object_get_double_member(t, "min-confidence");
+                    TS_INFO_MSG_V("\ttracker min-confidence:%f", c);
+                    config.tracker.minConfidence = (float)c;
+                }
+
+                if (json_object_has_member(t, "confidence-decay")) {
+                    gdouble d = json_object_get_double_member(t, "confidence-decay");
+                    TS_INFO_MSG_V("\ttracker confidence-decay:%f", d);
+                    config.tracker.confidenceDecay = (float)d;
+                }
+
+                if (json_object_has_member(t, "iou-thresh")) {
+                    gdouble i = json_object_get_double_member(t, "iou-thresh");
+                    TS_INFO_MSG_V("\ttracker iou-thresh:%f", i);
+                    config.tracker.iouThresh = (float)i;
+                }
+
+                if (json_object_has_member(t, "max-misses")) {
+                    gint m = json_object_get_int_member(t, "max-misses");
+                    TS_INFO_MSG_V("\ttracker max-misses:%d", m);
+                    config.tracker.maxMisses = m;
+                }
+
+                if (json_object_has_member(t, "min-hits")) {
+                    gint h = json_object_get_int_member(t, "min-hits");
+                    TS_INFO_MSG_V("\ttracker min-hits:%d", h);
+                    config.tracker.minHits = h;
+                }
+            }
+
+            if (json_object_has_member(object, "tiling")) {
+                JsonObject* t = json_object_get_object_member(object, "tiling");
+
+                if (json_object_has_member(t, "tile-width")) {
+                    gint w = json_object_get_int_member(t, "tile-width");
+                    TS_INFO_MSG_V("\ttiling tile-width:%d", w);
+                    config.tiling.tileWidth = w;
+                }
+
+                if (json_object_has_member(t, "tile-height")) {
+                    gint h = json_object_get_int_member(t, "tile-height");
+                    TS_INFO_MSG_V("\ttiling tile-height:%d", h);
+                    config.tiling.tileHeight = h;
+                }
+
+                if (json_object_has_member(t, "overlap")) {
+                    gint o = json_object_get_int_member(t, "overlap");
+                    TS_INFO_MSG_V("\ttiling overlap:%d", o);
+                    config.tiling.overlap = o;
+                }
+
+                if (json_object_has_member(t, "cols")) {
+                    gint c = json_object_get_int_member(t, "cols");
+                    TS_INFO_MSG_V("\ttiling cols:%d", c);
+                    config.tiling.cols = c;
+                }
+
+                if (json_object_has_member(t, "rows")) {
+                    gint r = json_object_get_int_member(t, "rows");
+                    TS_INFO_MSG_V("\ttiling rows:%d", r);
+                    config.tiling.rows = r;
+                }
+
+                if (json_object_has_member(t, "full-frame")) {
+                    gboolean f = json_object_get_boolean_member(t, "full-frame");
+                    TS_INFO_MSG_V("\ttiling full-frame:%s", f ? "true" : "false");
+                    config.tiling.fullFrame = f;
+                }
+            }
+
+            if (json_object_has_member(object, "fovea")) {
+                JsonObject* f = json_object_get_object_member(object, "fovea");
+
+                if (json_object_has_member(f, "max-crops")) {
+                    gint m = json_object_get_int_member(f, "max-crops");
+                    TS_INFO_MSG_V("\tfovea max-crops:%d", m);
+                    config.fovea.maxCrops = m;
+                }
+
+                if (json_object_has_member(f, "refine-thresh")) {
+                    gdouble r = json_object_get_double_member(f, "refine-thresh");
+                    TS_INFO_MSG_V("\tfovea refine-thresh:%f", r);
+                    config.fovea.refineThresh = (float)r;
+                }
+
+                if (json_object_has_member(f, "candidate-thresh")) {
+                    gdouble c = json_object_get_double_member(f, "candidate-thresh");
+                    TS_INFO_MSG_V("\tfovea candidate-thresh:%f", c);
+                    config.fovea.candidateThresh = (float)c;
+                }
+
+                if (json_object_has_member(f, "small-size")) {
+                    gint z = json_object_get_int_member(f, "small-size");
+                    TS_INFO_MSG_V("\tfovea small-size:%d", z);
+                    config.fovea.smallSize = z;
+                }
+            }
+
+            if (json_object_has_member(object, "batcher")) {
+                JsonObject* b = json_object_get_object_member(object, "batcher");
+
+                if (json_object_has_member(b, "batch-size")) {
+                    gint n = json_object_get_int_member(b, "batch-size");
+                    TS_INFO_MSG_V("\tbatcher batch-size:%d", n);
+                    config.batcher.maxBatch = n;
+                }
+
+                if (json_object_has_member(b, "max-wait-ms")) {
+                    gdouble w = json_object_get_double_member(b, "max-wait-ms");
+                    TS_INFO_MSG_V("\tbatcher max-wait-ms:%f", w);
+                    config.batcher.maxWaitUs = (int)(w * 1000);
+                }
+            }
+
+            // "engines": {"DSP": 2, "CPU": 4}, engines shared by the streams on each runtime
+            if (json_object_has_member(object, "engines")) {
+                JsonObject* e = json_object_get_object_member(object, "engines");
+                GList* names = json_object_get_members(e);
+
+                for (GList* n = names; n; n = n->next) {
+                    std::string r((const char*)n->data);
+                    gint c = json_object_get_int_member(e, r.c_str());
+                    TS_INFO_MSG_V("\tengines %s:%d", r.c_str(), c);
+                    config.engines[string2runtime(r)] = c;
+                }
+                g_list_free(names);
+            }
+
+            // "regions": [{"type":"exclude", "points":[[x, y], ...]}, ...]
+            if (json_object_has_member(object, "regions")) {
+                JsonArray* r = json_object_get_array_member(object, "regions");
+
+                for (guint i = 0; i < json_array_get_length(r); i++) {
+                    JsonObject* o = json_array_get_object_element(r, i);
+                    std::string type("include");
+                    if (json_object_has_member(o, "type")) {
+                        type = (const char*)json_object_get_string_member(o, "type");
+                    }
+
+                    std::vector<ts::TSPoint> polygon;
+                    if (json_object_has_member(o, "points")) {
+                        JsonArray* points = json_object_get_array_member(o, "points");
+                        for (guint j = 0; j < json_array_get_length(points); j++) {
+                            JsonArray* p = json_array_get_array_element(points, j);
+                            if (json_array_get_length(p) >= 2) {
+                                polygon.push_back(ts::TSPoint(json_array_get_double_element(p, 0),
+                                    json_array_get_double_element(p, 1)));
+                            }
+                        }
+                    }
+
+                    TS_INFO_MSG_V("\tregion:%s points:%zu", type.c_str(), polygon.size());
+                    if (0 == type.compare("exclude")) {
+                        config.excludeRegions.push_back(polygon);
+                    } else {
+                        config.includeRegions.push_back(polygon);
+                    }
+                }
+            }
+
             if (json_object_has_member(object, "roi")) {
                 JsonObject* r = json_object_get_object_member(object, "roi");
 
@@ -151,6 +589,31 @@ static bool parse_args(AlgConfig& config, const std::string& data)
                     config.roi.height = h;
                 }
             }
+
+            // "rois": [{"x":0, "y":0, "w":640, "h":360}, ...]
+            if (json_object_has_member(object, "rois")) {
+                JsonArray* r = json_object_get_array_member(object, "rois");
+
+                for (guint i = 0; i < json_array_get_length(r); i++) {
+                    JsonObject* o = json_array_get_object_element(r, i);
+                    ts::TSRect_T<int> roi(0, 0, 0, 0);
+                    if (json_object_has_member(o, "x")) {
+                        roi.x = json_object_get_int_member(o, "x");
+                    }
+                    if (json_object_has_member(o, "y")) {
+                        roi.y = json_object_get_int_member(o, "y");
+                    }
+                    if (json_object_has_member(o, "w")) {
+                        roi.width = json_object_get_int_member(o, "w");
+                    }
+                    if (json_object_has_member(o, "h")) {
+                        roi.height = json_object_get_int_member(o, "h");
+                    }
+
+                    TS_INFO_MSG_V("\troi:(%d, %d, %d, %d)", roi.x, roi.y, roi.width, roi.height);
+                    config.rois.push_back(roi);
+                }
+            }
         }
     } else {
         TS_ERR_MSG_V("Failed to parse json string %s(%s)\n",
@@ -201,12 +664,159 @@ static JsonObject* results_to_json_object(const std::vector<ts::ObjectData>& res
             std::to_string(results[i].width).c_str());
         json_object_set_string_member(jobject, "height",
             std::to_string(results[i].height).c_str());
+        if (results[i].track_id >= 0) {
+            json_object_set_string_member(jobject, "track-id",
+                std::to_string(results[i].track_id).c_str());
+        }
         json_array_add_object_element(jarray, jobject);
     }
 
     json_object_set_string_member(result, "alg-name", "yolov5s");
     json_object_set_array_member (result, "alg-result", jarray);
 
+    // Batch sizes and waits of the frames since the first stream of the batcher.
+    ts::BatcherStats bstats;
+    if (a->batcher_ && a->batcher_->GetStats(bstats)) {
+        JsonObject* jbatcher = json_object_new();
+        JsonArray*  jsizes = json_array_new();
+        JsonArray*  jwaits = json_array_new();
+        if (!jbatcher || !jsizes || !jwaits) {
+            TS_ERR_MSG_V("Failed to new a object with type JsonXyz");
+            return result;
+        }
+
+        for (size_t i = 0; i < bstats.batchSizes.size(); i++) {
+            json_array_add_int_element(jsizes, bstats.batchSizes[i]);
+        }
+        for (size_t i = 0; i < bstats.waits.size(); i++) {
+            json_array_add_int_element(jwaits, bstats.waits[i]);
+        }
+        json_object_set_int_member(jbatcher, "frames", bstats.frames);
+        json_object_set_int_member(jbatcher, "batches", bstats.batches);
+        json_object_set_array_member(jbatcher, "batch-sizes", jsizes);
+        json_object_set_array_member(jbatcher, "waits-log2-us", jwaits);
+        json_object_set_object_member(result, "batcher", jbatcher);
+    }
+
+    // Engines shared with the other streams since the first one started.
+    ts::EngineStats estats;
+    if (!a->batcher_ && !a->args_.empty() && a->alg_->GetEngineStats(estats)) {
+        JsonObject* jengines = json_object_new();
+        JsonArray*  jwaits = json_array_new();
+        if (!jengines || !jwaits) {
+            TS_ERR_MSG_V("Failed to new a object with type JsonXyz");
+            return result;
+        }
+
+        for (size_t i = 0; i < estats.waits.size(); i++) {
+            json_array_add_int_element(jwaits, estats.waits[i]);
+        }
+        json_object_set_int_member(jengines, "engines", estats.engines);
+        json_object_set_int_member(jengines, "acquires", estats.acquires);
+        json_object_set_int_member(jengines, "waited", estats.waited);
+        json_object_set_array_member(jengines, "waits-log2-us", jwaits);
+        json_object_set_object_member(result, "engines", jengines);
+    }
+
+    // Second pass counters since algInit.
+    ts::FoveaStats fstats;
+    if (a->cfg_.fovea.maxCrops > 0 && a->alg_->GetFoveaStats(fstats)) {
+        JsonObject* jfovea = json_object_new();
+        if (!jfovea) {
+            TS_ERR_MSG_V("Failed to new a object with type JsonObject");
+            return result;
+        }
+
+        json_object_set_int_member(jfovea, "frames", fstats.frames);
+        json_object_set_int_member(jfovea, "candidates", fstats.candidates);
+        json_object_set_int_member(jfovea, "crops", fstats.crops);
+        json_object_set_object_member(result, "fovea", jfovea);
+    }
+
+    // Tracker counters since algInit.
+    ts::TrackerStats tstats;
+    if (a->cfg_.tracker.detectInterval > 0 && a->alg_->GetTrackerStats(tstats)) {
+        JsonObject* jtracker = json_object_new();
+        if (!jtracker) {
+            TS_ERR_MSG_V("Failed to new a object with type JsonObject");
+            return result;
+        }
+
+        json_object_set_int_member(jtracker, "frames", tstats.frames);
+        json_object_set_int_member(jtracker, "keyframes", tstats.keyframes);
+        json_object_set_object_member(result, "tracker", jtracker);
+    }
+
+    // Motion gate counters since algInit.
+    ts::MotionStats stats;
+    if (a->cfg_.motion.maxSkip > 0 && a->alg_->GetMotionStats(stats)) {
+        JsonObject* jmotion = json_object_new();
+        if (!jmotion) {
+            TS_ERR_MSG_V("Failed to new a object with type JsonObject");
+            return result;
+        }
+
+        json_object_set_int_member(jmotion, "frames", stats.frames);
+        json_object_set_int_member(jmotion, "skipped", stats.skipped);
+        json_object_set_int_member(jmotion, "cropped", stats.cropped);
+        json_object_set_int_member(jmotion, "full", stats.full);
+        json_object_set_object_member(result, "motion", jmotion);
+    }
+
+    return result;
+}
+
+//
+// counts_to_json_object
+//
+static JsonObject* counts_to_json_object(const std::vector<int>& counts,
+    const ts::DensityMap* density, void* alg)
+{
+    AlgCore* a = static_cast<AlgCore*>(alg);
+    JsonObject* result = json_object_new();
+    JsonObject* jcounts = json_object_new();
+
+    if (!result || !jcounts) {
+        TS_ERR_MSG_V("Failed to new a object with type JsonXyz");
+        return NULL;
+    }
+
+    // Only the classes seen in the frame, keeps the message small.
+    int total = 0;
+    for (int i = 0; i < (int)counts.size(); i++) {
+        if (counts[i] > 0) {
+            json_object_set_int_member(jcounts, i < (int)a->labels_.size() ?
+                a->labels_[i].c_str() : std::to_string(i).c_str(), counts[i]);
+            total += counts[i];
+        }
+    }
+
+    json_object_set_string_member(result, "alg-name", "yolov5s");
+    json_object_set_int_member   (result, "total", total);
+    json_object_set_object_member(result, "alg-result", jcounts);
+
+    if (density) {
+        JsonObject* jdensity = json_object_new();
+        JsonArray*  jvalues = json_array_new();
+        if (!jdensity || !jvalues) {
+            TS_ERR_MSG_V("Failed to new a object with type JsonXyz");
+            return result;
+        }
+
+        json_object_set_int_member   (jdensity, "rows", density->rows);
+        json_object_set_int_member   (jdensity, "cols", density->cols);
+        json_object_set_double_member(jdensity, "x", density->x);
+        json_object_set_double_member(jdensity, "y", density->y);
+        json_object_set_double_member(jdensity, "cell-width", density->cellWidth);
+        json_object_set_double_member(jdensity, "cell-height", density->cellHeight);
+        // Scores in percent, 0 to 100.
+        for (float v : density->value) {
+            json_array_add_int_element(jvalues, (gint64)(v * 100.0f + 0.5f));
+        }
+        json_object_set_array_member(jdensity, "values", jvalues);
+        json_object_set_object_member(result, "density", jdensity);
+    }
+
     return result;
 }
 
@@ -225,9 +835,32 @@ static void results_to_osd_object(const std::vector<ts::ObjectData>& results,
             0, text, TsObjectType::OBJECT));
     }
 
-    osd.push_back(TsOsdObject(a->cfg_.roi.x, a->cfg_.roi.y, 
-        a->cfg_.roi.width, a->cfg_.roi.height, 0, 
-        255, 0, 0, std::string(""), TsObjectType::ROI));
+    if (!a->cfg_.rois.empty()) {
+        for (const auto& roi : a->cfg_.rois) {
+            osd.push_back(TsOsdObject(roi.x, roi.y, roi.width, roi.height, 0,
+                255, 0, 0, std::string(""), TsObjectType::ROI));
+        }
+    } else if (!a->cfg_.roi.empty()) {
+        osd.push_back(TsOsdObject(a->cfg_.roi.x, a->cfg_.roi.y, 
+            a->cfg_.roi.width, a->cfg_.roi.height, 0, 
+            255, 0, 0, std::string(""), TsObjectType::ROI));
+    }
+}
+
+//
+// init_model: build the engines, or share those of a stream with the same arguments
+//
+static bool init_model(AlgCore* a, const std::string& args, const bool shareEngines)
+{
+    if (shareEngines) {
+        std::lock_guard<std::mutex> lock(g_sharedMutex);
+        auto it = g_shared.find(args);
+        if (g_shared.end() != it) {
+            return a->alg_->InitShared(*it->second->alg_);
+        }
+    }
+
+    return a->alg_->Init(a->cfg_.modelPath, a->cfg_.runtime);
 }
 
 //
@@ -252,12 +885,74 @@ void* algInit(const std::string& args)
         a->labels_.push_back(line);
     }           
 
+    // Streams with the same arguments share one detector and batch their frames,
+    // or else run on a pool of engines of the runtime, if any is configured.
+    const bool batched = a->cfg_.batcher.maxBatch > 1 && OUTPUT_BOXES == a->cfg_.outputMode;
+    const auto count = a->cfg_.engines.find(a->cfg_.runtime);
+    const int engines = (batched || a->cfg_.engines.end() == count) ? 0 : count->second;
+
+    // A batch mixes the frames of several streams, only the per frame settings apply to it.
+    if (batched && (!a->cfg_.rois.empty() || a->cfg_.tiling.tileWidth > 0 ||
+        a->cfg_.tiling.tileHeight > 0 || a->cfg_.fovea.maxCrops > 0 ||
+        a->cfg_.motion.maxSkip > 0 || a->cfg_.tracker.detectInterval > 0)) {
+        TS_ERR_MSG_V("Batching(batch-size:%d) can't be combined with rois, tiling, fovea, "
+            "motion gate or tracker.", a->cfg_.batcher.maxBatch);
+        goto done;
+    }
+
+    if (batched) {
+        std::lock_guard<std::mutex> lock(g_sharedMutex);
+        auto it = g_shared.find(args);
+        if (g_shared.end() != it) {
+            a->alg_ = it->second->alg_;
+            a->batcher_ = it->second->batcher_;
+            a->args_ = args;
+            it->second->refs_++;
+            return (void*)a;
+        }
+    }
+
     if (!(a->alg_ = new ts::TSObjectDetection())) {
         TS_ERR_MSG_V("Failed to new a object with type TSFaceDetection");
         goto done;
     }
 
-    a->alg_->Init(a->cfg_.modelPath, a->cfg_.runtime);
+    if (!a->alg_->SetObjectSize(a->cfg_.minSize, a->cfg_.maxSize)) {
+        TS_ERR_MSG_V("Failed to set object size [%d, %d].", a->cfg_.minSize, a->cfg_.maxSize);
+        goto done;
+    }
+
+    if (!a->alg_->SetInputSize(a->cfg_.inputWidth, a->cfg_.inputHeight)) {
+        TS_ERR_MSG_V("Failed to set input size %dx%d.", a->cfg_.inputWidth, a->cfg_.inputHeight);
+        goto done;
+    }
+
+    // A batched input needs a fixed input size, else the frames are run one by one.
+    if (batched && a->cfg_.inputWidth > 0 && a->cfg_.inputHeight > 0 &&
+        !a->alg_->SetBatchSize(a->cfg_.batcher.maxBatch)) {
+        TS_ERR_MSG_V("Failed to set batch size(%d).", a->cfg_.batcher.maxBatch);
+        goto done;
+    }
+
+    if (!a->alg_->SetInputEncoding(a->cfg_.inputEncoding)) {
+        TS_ERR_MSG_V("Failed to set input encoding.");
+        goto done;
+    }
+
+    if (!a->alg_->SetOutputEncoding(a->cfg_.outputEncoding)) {
+        TS_ERR_MSG_V("Failed to set output encoding.");
+        goto done;
+    }
+
+    if (engines > 0 && !a->alg_->SetEngineCount(engines)) {
+        TS_ERR_MSG_V("Failed to set engine count(%d).", engines);
+        goto done;
+    }
+
+    if (!init_model(a, args, engines > 0)) {
+        TS_ERR_MSG_V("Failed to init model %s.", a->cfg_.modelPath.c_str());
+        goto done;
+    }
 
     if (!a->alg_->SetScoreThreshold(a->cfg_.confThresh, a->cfg_.nmsThresh)) {
         TS_ERR_MSG_V("Failed to set score thresh(%f, %f)",
@@ -270,6 +965,96 @@ void* algInit(const std::string& args)
         goto done;
     }
 
+    if (!a->alg_->SetROIs(a->cfg_.rois)) {
+        TS_ERR_MSG_V("Failed to set ROIs(%zu).", a->cfg_.rois.size());
+        goto done;
+    }
+
+    if (!a->alg_->SetRegions(a->cfg_.includeRegions, a->cfg_.excludeRegions)) {
+        TS_ERR_MSG_V("Failed to set regions.");
+        goto done;
+    }
+
+    if (!a->alg_->SetMotionGate(a->cfg_.motion)) {
+        TS_ERR_MSG_V("Failed to set motion gate(max-skip:%d).", a->cfg_.motion.maxSkip);
+        goto done;
+    }
+
+    if (!a->alg_->SetTracker(a->cfg_.tracker)) {
+        TS_ERR_MSG_V("Failed to set tracker(detect-interval:%d).", a->cfg_.tracker.detectInterval);
+        goto done;
+    }
+
+    if (!a->alg_->SetTiling(a->cfg_.tiling)) {
+        TS_ERR_MSG_V("Failed to set tiling(tile-width:%d, tile-height:%d, overlap:%d).",
+            a->cfg_.tiling.tileWidth, a->cfg_.tiling.tileHeight, a->cfg_.tiling.overlap);
+        goto done;
+    }
+
+    if (!a->alg_->SetFovea(a->cfg_.fovea)) {
+        TS_ERR_MSG_V("Failed to set fovea(max-crops:%d).", a->cfg_.fovea.maxCrops);
+        goto done;
+    }
+
+    if (!a->alg_->SetInterpolation(a->cfg_.interp)) {
+        TS_ERR_MSG_V("Failed to set interpolation.");
+        goto done;
+    }
+
+    if (!a->alg_->SetPreProcessThreads(a->cfg_.preThreads)) {
+        TS_ERR_MSG_V("Failed to set preprocess threads(%d).", a->cfg_.preThreads);
+        goto done;
+    }
+
+    if (!a->alg_->SetClasses(a->cfg_.classes, a->cfg_.classThresh)) {
+        TS_ERR_MSG_V("Failed to set classes.");
+        goto done;
+    }
+
+    if (!a->alg_->SetPostProcessThreads(a->cfg_.postThreads)) {
+        TS_ERR_MSG_V("Failed to set postprocess threads(%d).", a->cfg_.postThreads);
+        goto done;
+    }
+
+    if (!a->alg_->SetClassAwareNMS(a->cfg_.classAwareNms)) {
+        TS_ERR_MSG_V("Failed to set class aware NMS.");
+        goto done;
+    }
+
+    if (!a->alg_->SetDetectionLimits(a->cfg_.topK, a->cfg_.maxDetections)) {
+        TS_ERR_MSG_V("Failed to set detection limits(top-k:%d, max-detections:%d).",
+            a->cfg_.topK, a->cfg_.maxDetections);
+        goto done;
+    }
+
+    if (!a->alg_->SetBestClassOnly(a->cfg_.bestClassOnly)) {
+        TS_ERR_MSG_V("Failed to set best class only.");
+        goto done;
+    }
+
+    if (batched || engines > 0) {
+        std::lock_guard<std::mutex> lock(g_sharedMutex);
+        auto it = g_shared.find(args);
+        if (g_shared.end() != it) {
+            if (batched) {
+                // Another stream initialized the same detector meanwhile.
+                delete a->alg_;
+                a->alg_ = it->second->alg_;
+                a->batcher_ = it->second->batcher_;
+            }
+            it->second->refs_++;
+        } else {
+            AlgShared* shared = new AlgShared();
+            shared->alg_ = a->alg_;
+            if (batched) {
+                shared->batcher_ = a->batcher_ = new ts::TSBatcher(*a->alg_, a->cfg_.batcher);
+            }
+            shared->refs_ = 1;
+            g_shared[args] = shared;
+        }
+        a->args_ = args;
+    }
+
     return (void*)a;
 
 done:
@@ -304,15 +1089,19 @@ std::shared_ptr<TsJsonObject> algProc(
 
     GstSample* sample = data->GetSample();
 
-    gint width, height, type = TYPE_RGB_U8;
     GstCaps* caps = gst_sample_get_caps(sample);
-    GstStructure* structure = gst_caps_get_structure(caps, 0);
-    gst_structure_get_int(structure, "width", &width);
-    gst_structure_get_int(structure, "height", &height);
-    std::string format((char*)gst_structure_get_string(
-        structure, "format"));
-    if (0 != format.compare("RGB")) {
-        TS_ERR_MSG_V("Invalid format(%s!=RGB)", format.c_str());
+    GstVideoInfo info;
+    if (!gst_video_info_from_caps(&info, caps)) {
+        TS_ERR_MSG_V("Failed to parse video info from caps");
+        gst_sample_unref(sample);
+        return NULL;
+    }
+
+    // Decoded YUV frames are letterboxed natively, no videoconvert needed upstream.
+    gint type = string2format(GST_VIDEO_INFO_NAME(&info));
+    if (TYPE_UNKNOWN == type) {
+        TS_ERR_MSG_V("Invalid format(%s), expected RGB/BGR/RGBx/BGRx/NV12/I420",
+            GST_VIDEO_INFO_NAME(&info));
         gst_sample_unref(sample);
         return NULL;
     }
@@ -320,15 +1109,43 @@ std::shared_ptr<TsJsonObject> algProc(
     GstMapInfo map;
     GstBuffer* buf = gst_sample_get_buffer(sample);
     gst_buffer_map(buf, &map, GST_MAP_READ);
-    ts::TSImgData image(width, height, TYPE_RGB_U8, map.data);
-    gst_buffer_unmap(buf, &map);
+
+    uint8_t* planes[3] = { NULL, NULL, NULL };
+    int32_t  strides[3] = { 0, 0, 0 };
+    for (guint i = 0; i < GST_VIDEO_INFO_N_PLANES(&info) && i < 3; i++) {
+        planes[i]  = map.data + GST_VIDEO_INFO_PLANE_OFFSET(&info, i);
+        strides[i] = GST_VIDEO_INFO_PLANE_STRIDE(&info, i);
+    }
+    ts::TSImgData image(GST_VIDEO_INFO_WIDTH(&info), GST_VIDEO_INFO_HEIGHT(&info),
+        type, planes, strides);
+
+    if (OUTPUT_BOXES != a->cfg_.outputMode) {
+        // No box is built, only the counts and the ROI are reported.
+        std::vector<int> counts;
+        ts::DensityMap density;
+        ts::DensityMap* pdensity = OUTPUT_DENSITY == a->cfg_.outputMode ? &density : NULL;
+        if (!a->alg_->Count(image, counts, pdensity)) {
+            TS_WARN_MSG_V("Failed to count objects in the image");
+        }
+
+        gst_buffer_unmap(buf, &map);
+
+        std::shared_ptr<TsJsonObject> jo = std::make_shared<
+            TsJsonObject>(counts_to_json_object(counts, pdensity, a));
+        results_to_osd_object(std::vector<ts::ObjectData>(), jo->GetOsdObject(), a);
+
+        a->cb_put_result_(jo, data, a->cb_user_data_);
+        return nullptr;
+    }
 
     std::vector<ts::ObjectData> results;
-    if (!a->alg_->Detect(image, results)) {
+    if (!(a->batcher_ ? a->batcher_->Detect(image, results) : a->alg_->Detect(image, results))) {
         TS_WARN_MSG_V("Failed to detect face in the image");
         //return NULL;
     }
 
+    gst_buffer_unmap(buf, &map);
+
     std::shared_ptr<TsJsonObject> jo = std::make_shared<
         TsJsonObject>(results_to_json_object(results, a));
     results_to_osd_object(results, jo->GetOsdObject(), a);
@@ -421,7 +1238,23 @@ void algFina(void* alg)
 
     TS_INFO_MSG_V("algFina called");
 
-    delete a->alg_;
+    if (!a->args_.empty()) {
+        // Streams on an engine pool have their own detector, the one lending its
+        // engines and a shared detector are released by the last stream.
+        std::lock_guard<std::mutex> lock(g_sharedMutex);
+        AlgShared* shared = g_shared[a->args_];
+        if (a->alg_ != shared->alg_) {
+            delete a->alg_;
+        }
+        if (0 == --shared->refs_) {
+            g_shared.erase(a->args_);
+            delete shared->batcher_;
+            delete shared->alg_;
+            delete shared;
+        }
+    } else {
+        delete a->alg_;
+    }
 
     delete a;
 }
@@ -22,6 +22,7 @@
 #include <json-glib/json-glib.h>
 #include <uuid/uuid.h>
 #include <gst/gst.h>
+#include <gst/video/video.h>
 
 //
 // TS_ERR_MSG_V / TS_INFO_MSG_V / TS_WARN_MSG_V
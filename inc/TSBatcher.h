@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2012-2022
+ * All Rights Reserved by Thundercomm Technology Co., Ltd. and its affiliates.
+ * You may not use, copy, distribute, modify, transmit in any form this file
+ * except in compliance with THUNDERCOMM in writing by applicable law.
+ *
+ * @Description: Dynamic batching of the frames of concurrent streams into one detector.
+ * @version: 1.0
+ * @Author: Ricardo Lu<sheng.lu@thundercomm.com>
+ * @Date: 2026-10-17 19:12:46
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-17 19:12:46
+ */
+
+#ifndef __TS_BATCHER_H__
+#define __TS_BATCHER_H__
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "TSYolov5s.h"
+
+namespace ts
+{
+
+/**
+ * @brief: Dynamic batching parameters.
+ */
+struct BatcherParams {
+    // Frames per batch at most, best set to the batch size of the model, 1 runs them one by one.
+    int maxBatch = 1;
+    // Longest wait of a frame for the batch to fill, in microseconds.
+    int maxWaitUs = 5000;
+};
+
+/**
+ * @brief: Batcher counters since it was created.
+ */
+struct BatcherStats {
+    // Frames detected
+    size_t frames = 0;
+    // Batched inferences
+    size_t batches = 0;
+    // Batches of each size, indexed by their number of frames
+    std::vector<size_t> batchSizes;
+    // Frames by wait before their batch started, bucket 0 counts the waits under 1 us,
+    // bucket i those in [2^(i-1), 2^i) us and the last one everything above
+    std::vector<size_t> waits;
+};
+
+/**
+ * @brief: Dynamic batcher in front of one detector shared by several streams.
+ * Each stream calls Detect() from its own thread with a single frame. The frames are
+ * queued until maxBatch of them are waiting or the oldest one waited maxWaitUs, then
+ * the caller leading the batch runs one batched Detect of the detector for all of
+ * them and hands each caller its own results. The detector must only be used through
+ * the batcher, and its stream features (motion gate, tracker...) don't apply.
+ */
+class TSBatcher {
+public:
+    /**
+     * @brief: Constructor.
+     * @Author: Ricardo Lu
+     * @param {ts::TSObjectDetection&} detector: Initialized detector, it must outlive the batcher.
+     * @param {ts::BatcherParams&} params: Batch size and wait limits.
+     */
+    TSBatcher(TSObjectDetection& detector, const BatcherParams& params);
+
+    TSBatcher(const TSBatcher&) = delete;
+    TSBatcher& operator=(const TSBatcher&) = delete;
+
+    /**
+     * @brief: Detect one frame within the next batch, blocks until its results are ready.
+     * @Author: Ricardo Lu
+     * @param {ts::TSImgData&} image: A RGB/BGR/RGBX/BGRX/NV12/I420 format image needs to be detected.
+     * @param {std::vector<ts::ObjectData>&} results: Detection results vector.
+     * @return {bool} true if detect successfullly, false if failed.
+     */
+    bool Detect(const TSImgData& image, std::vector<ObjectData>& results);
+
+    /**
+     * @brief: Get the batch size and wait histograms.
+     * @Author: Ricardo Lu
+     * @param {ts::BatcherStats&} stats: Frames, batches and histograms.
+     * @return {bool} true if getter successfully, false if failed.
+     */
+    bool GetStats(BatcherStats& stats);
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    // One waiting frame, on the stack of its caller.
+    struct Request {
+        const TSImgData* image = nullptr;
+        std::vector<ObjectData>* results = nullptr;
+        Clock::time_point arrival;
+        bool done = false;
+        bool ok = false;
+    };
+
+    TSObjectDetection& m_detector;
+    BatcherParams m_params;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<Request*> m_queue;
+    // A caller is collecting or running a batch.
+    bool m_leader = false;
+    BatcherStats m_stats;
+
+    // Work buffers of the leader.
+    std::vector<Request*> m_batch;
+    std::vector<TSImgData> m_images;
+    std::vector<std::vector<ObjectData> > m_results;
+};
+
+} // namespace ts
+
+#endif // __TS_BATCHER_H__
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2012-2022
+ * All Rights Reserved by Thundercomm Technology Co., Ltd. and its affiliates.
+ * You may not use, copy, distribute, modify, transmit in any form this file
+ * except in compliance with THUNDERCOMM in writing by applicable law.
+ *
+ * @Description: Struct-of-arrays detection buffer reused from frame to frame.
+ * @version: 1.0
+ * @Author: Ricardo Lu<sheng.lu@thundercomm.com>
+ * @Date: 2026-10-17 19:20:44
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-17 19:20:44
+ */
+
+#ifndef __TS_DETECTIONS_H__
+#define __TS_DETECTIONS_H__
+
+#include <memory>
+
+#include "TSYolov5s.h"
+
+namespace ts
+{
+
+/**
+ * @brief: Detections stored as x/y/width/height/confidence/label arrays.
+ * All arrays live in one arena which only grows: clear() keeps the memory,
+ * so a buffer reused every frame stops allocating once it reached the peak size.
+ */
+class TSDetections {
+public:
+    TSDetections() = default;
+    TSDetections(const TSDetections&) = delete;
+    TSDetections& operator=(const TSDetections&) = delete;
+
+    size_t size() const { return m_size; }
+    bool empty() const { return 0 == m_size; }
+
+    void clear() { m_size = 0; }
+
+    /**
+     * @brief: Make room for capacity detections, the current ones are kept.
+     */
+    void reserve(const size_t capacity);
+
+    /**
+     * @brief: Drop the detections from index size on, size must not be larger than size().
+     */
+    void truncate(const size_t size) { m_size = size; }
+
+    /**
+     * @brief: Set the number of detections, the ones added are undefined until set() or copy().
+     */
+    void resize(const size_t size) {
+        reserve(size);
+        m_size = size;
+    }
+
+    void push_back(const int x, const int y, const int width, const int height,
+        const float confidence, const int label) {
+        if (m_size == m_capacity) {
+            reserve(m_capacity ? m_capacity * 2 : 256);
+        }
+        set(m_size++, x, y, width, height, confidence, label);
+    }
+
+    void set(const size_t i, const int x, const int y, const int width, const int height,
+        const float confidence, const int label) {
+        m_x[i] = x;
+        m_y[i] = y;
+        m_width[i] = width;
+        m_height[i] = height;
+        m_confidence[i] = confidence;
+        m_label[i] = label;
+    }
+
+    /**
+     * @brief: Copy detection from of another buffer to index to of this one.
+     */
+    void copy(const size_t to, const TSDetections& src, const size_t from) {
+        set(to, src.m_x[from], src.m_y[from], src.m_width[from], src.m_height[from],
+            src.m_confidence[from], src.m_label[from]);
+    }
+
+    TSRect_T<int> rect(const size_t i) const {
+        return TSRect_T<int>(m_x[i], m_y[i], m_width[i], m_height[i]);
+    }
+
+    int* x() { return m_x; }
+    int* y() { return m_y; }
+    int* width() { return m_width; }
+    int* height() { return m_height; }
+    float* confidence() { return m_confidence; }
+    int* label() { return m_label; }
+
+    const int* x() const { return m_x; }
+    const int* y() const { return m_y; }
+    const int* width() const { return m_width; }
+    const int* height() const { return m_height; }
+    const float* confidence() const { return m_confidence; }
+    const int* label() const { return m_label; }
+
+    /**
+     * @brief: Zero-copy view, valid until this buffer is modified.
+     */
+    DetectionView view() const;
+
+    void swap(TSDetections& other);
+
+private:
+    // Raw storage of the 6 arrays, each one m_capacity entries of 4 bytes.
+    std::unique_ptr<unsigned char[]> m_arena;
+    size_t m_size = 0;
+    size_t m_capacity = 0;
+
+    int* m_x = nullptr;
+    int* m_y = nullptr;
+    int* m_width = nullptr;
+    int* m_height = nullptr;
+    float* m_confidence = nullptr;
+    int* m_label = nullptr;
+};
+
+} // namespace ts
+
+#endif // __TS_DETECTIONS_H__
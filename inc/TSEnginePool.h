@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2012-2022
+ * All Rights Reserved by Thundercomm Technology Co., Ltd. and its affiliates.
+ * You may not use, copy, distribute, modify, transmit in any form this file
+ * except in compliance with THUNDERCOMM in writing by applicable law.
+ *
+ * @Description: Pool of SNPE engines built from one model, shared by several detectors.
+ * @version: 1.0
+ * @Author: Ricardo Lu<sheng.lu@thundercomm.com>
+ * @Date: 2026-10-17 20:41:09
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-17 20:41:09
+ */
+
+#ifndef __TS_ENGINE_POOL_H__
+#define __TS_ENGINE_POOL_H__
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "SNPETask.h"
+#include "TSYolov5s.h"
+
+namespace ts
+{
+
+/**
+ * @brief: SNPE engines of one model, each with its own user buffers.
+ * The model container is opened once and every engine is built from it with the same
+ * configuration. A detector acquires an idle engine for one frame, letterboxes into its
+ * input, executes and decodes its outputs, then releases it. Callers finding every
+ * engine busy wait in arrival order.
+ */
+class TSEnginePool {
+public:
+    ~TSEnginePool();
+
+    /**
+     * @brief: Build the engines.
+     * @param {std::string&} model_path: Model file, opened once.
+     * @param {runtime_t} runtime: Runtime of every engine.
+     * @param {int} count: Number of engines.
+     * @param {std::function} setup: Called on each engine before its init, sets its
+     * output layers, input dimensions and encodings, returns false if any failed.
+     * @return {bool} true if every engine is built, false if any failed: the pool is then empty.
+     */
+    bool init(const std::string& model_path, const runtime_t runtime, const int count,
+        const std::function<bool(snpetask::SNPETask&)>& setup);
+
+    int size() const {
+        return static_cast<int>(m_engines.size());
+    }
+
+    /**
+     * @brief: An engine, only for its shapes while it isn't acquired.
+     */
+    snpetask::SNPETask* engine(const int index) const {
+        return m_engines[index].task.get();
+    }
+
+    /**
+     * @brief: Wait for an idle engine, preferably the last one released by the same user.
+     * @param {void*} user: Identity of the caller.
+     * @param {bool&} reused: true if the caller was the last one to use the engine, its
+     * input tensor then still holds what the caller wrote into it.
+     * @return {snpetask::SNPETask*} The engine, to be given back to release().
+     */
+    snpetask::SNPETask* acquire(const void* user, bool& reused);
+
+    void release(snpetask::SNPETask* task);
+
+    void stats(ts::EngineStats& stats);
+
+private:
+    void clear();
+
+    struct Engine {
+        std::unique_ptr<snpetask::SNPETask> task;
+        bool busy = false;
+        const void* lastUser = nullptr;
+    };
+
+    std::vector<Engine> m_engines;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    // Callers waiting for an engine, served in arrival order.
+    size_t m_nextTicket = 0;
+    size_t m_serving = 0;
+    ts::EngineStats m_stats;
+};
+
+} // namespace ts
+
+#endif // __TS_ENGINE_POOL_H__
@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2012-2022
+ * All Rights Reserved by Thundercomm Technology Co., Ltd. and its affiliates.
+ * You may not use, copy, distribute, modify, transmit in any form this file
+ * except in compliance with THUNDERCOMM in writing by applicable law.
+ *
+ * @Description: Fused letterbox kernel filling the network input tensor.
+ * @version: 1.1
+ * @Author: Ricardo Lu<sheng.lu@thundercomm.com>
+ * @Date: 2026-10-17 10:21:37
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-17 10:21:37
+ */
+
+#ifndef __TS_LETTERBOX_H__
+#define __TS_LETTERBOX_H__
+
+#include <vector>
+
+#include "TSStruct.h"
+#include "TSThreadPool.h"
+
+namespace ts
+{
+
+/**
+ * @brief: Letterbox an image into a RGB HWC tensor in a single pass.
+ * Color conversion, resize, gray padding and u8 to [0, 1] normalization are fused,
+ * the source image is only read and never modified. The normalized values are
+ * written as float32, TF8 codes or FP16 depending on the tensor encoding.
+ * The geometry and resize tables are cached until the source size, the tensor, the
+ * window or the interpolation changes, the gray padding is only written on such a change.
+ */
+class TSLetterbox {
+public:
+    /**
+     * @brief: Select the resize interpolation, INTERP_LINEAR by default.
+     * @param {interp_t} interp: Nearest is the fastest, area gives the best quality on downscale.
+     */
+    void setInterpolation(const interp_t interp) {
+        m_interp = interp;
+    }
+
+    /**
+     * @brief: Letterbox into a window of the tensor instead of the whole of it,
+     * several letterboxes can then share one tensor. Only the window is written,
+     * its padding included, or the padded area around it if one is given.
+     * @param {TSRect_T<int>&} window: Window in tensor pixels, empty for the whole tensor.
+     * @param {TSRect_T<int>&} area: Area containing the window, the rest of it is padding.
+     * Empty for the window alone.
+     */
+    void setWindow(const TSRect_T<int>& window, const TSRect_T<int>& area = TSRect_T<int>(0, 0, 0, 0)) {
+        m_window = window;
+        m_area = area;
+    }
+
+    /**
+     * @brief: Select the element encoding of the tensor, ENCODING_FLOAT by default.
+     * @param {encoding_t} encoding: ENCODING_FLOAT, ENCODING_TF8 or ENCODING_FP16.
+     * @param {float} step: TF8 quantization step, a value v is written as round(v / step) + offset.
+     * @param {int} offset: TF8 code of 0.
+     * @return {bool} true if the encoding is supported, false if not.
+     */
+    bool setEncoding(const encoding_t encoding, const float step = 1.0f / 255.0f, const int offset = 0);
+
+    /**
+     * @brief: Letterbox the image into the tensor.
+     * @param {ts::TSImgData&} image: RGB, BGR, RGBX, BGRX, NV12 or I420 source image.
+     * @param {void*} tensor: Destination tensor, tensorHeight * tensorWidth * 3 elements
+     * of the encoding set by setEncoding().
+     * @param {TSThreadPool*} pool: Split the rows into one band per pool thread if not null.
+     * @return {bool} true if letterboxed successfully, false if failed.
+     */
+    bool run(const ts::TSImgData& image, void* tensor, int tensorWidth, int tensorHeight,
+        TSThreadPool* pool = nullptr);
+
+    /**
+     * @brief: Drop the cached geometry, the next run() rewrites the whole tensor.
+     * Must be called if anything else wrote into the tensor.
+     */
+    void invalidate() {
+        m_valid = false;
+    }
+
+    float scale() const { return m_scale; }
+    int xOffset() const { return m_xOffset; }
+    int yOffset() const { return m_yOffset; }
+    int scaledWidth() const { return m_scaledWidth; }
+    int scaledHeight() const { return m_scaledHeight; }
+
+private:
+    struct Source {
+        const uint8_t* data = nullptr;
+        int stride = 0;
+        // Chroma samples of YUV 4:2:0 images, u and v share the same layout.
+        const uint8_t* u = nullptr;
+        const uint8_t* v = nullptr;
+        int uvStride = 0;
+    };
+
+    bool configure(int srcWidth, int srcHeight, int srcFormat,
+        void* tensor, int tensorWidth, int tensorHeight);
+    void buildTables(int srcWidth, int srcHeight);
+
+    // Conversion of a normalized value, overloaded on the tensor element type.
+    void store(float* dst, float v) const;
+    void store(uint8_t* dst, float v) const;
+    void store(uint16_t* dst, float v) const;
+    // Converted value of each u8 / 255.
+    const float* normTable(const float*) const;
+    const uint8_t* normTable(const uint8_t*) const { return m_normTf8; }
+    const uint16_t* normTable(const uint16_t*) const { return m_normFp16; }
+
+    template <typename T>
+    void fill(const Source& in, T* tensor, bool padding, TSThreadPool* pool) const;
+    template <typename T>
+    void fillPadding(T* tensor) const;
+    template <typename T>
+    void fillRow(const Source& in, T* dst, int dy) const;
+    template <typename T>
+    void fillRowYuv(const Source& in, T* dst, int dy) const;
+
+    interp_t m_interp = INTERP_LINEAR;
+    TSRect_T<int> m_window = {0, 0, 0, 0};
+    TSRect_T<int> m_area = {0, 0, 0, 0};
+
+    encoding_t m_encoding = ENCODING_FLOAT;
+    float m_quantScale = 255.0f;
+    int m_quantOffset = 0;
+    uint8_t m_normTf8[256];
+    uint16_t m_normFp16[256];
+
+    // Cache key of the geometry below.
+    bool m_valid = false;
+    int m_srcWidth = 0;
+    int m_srcHeight = 0;
+    int m_srcFormat = TYPE_UNKNOWN;
+    void* m_tensor = nullptr;
+    interp_t m_tableInterp = INTERP_LINEAR;
+    // Window actually written, the whole tensor if none is set.
+    TSRect_T<int> m_tableWindow = {0, 0, 0, 0};
+    TSRect_T<int> m_tableArea = {0, 0, 0, 0};
+
+    int m_tensorWidth = 0;
+    int m_tensorHeight = 0;
+    int m_scaledWidth = 0;
+    int m_scaledHeight = 0;
+    int m_xOffset = 0;
+    int m_yOffset = 0;
+    float m_scale = 1.0f;
+
+    // Source byte offset of the 3 rgb channels, swapped for bgr input.
+    int m_channelIdx[3] = {0, 1, 2};
+    // Bytes per source pixel, the Y plane of YUV input is handled as 1 byte pixels.
+    int m_pixelStep = 3;
+    bool m_yuv = false;
+
+    // Per destination column/row source coordinates and fixed-point weights.
+    // Linear: [idx0, idx1] with weight of idx1; Nearest: idx0; Area: [idx0, idx1).
+    std::vector<int> m_xIdx0, m_xIdx1, m_xWeight;
+    std::vector<int> m_yIdx0, m_yIdx1, m_yWeight;
+    // Chroma sample offset of each destination column/row for YUV input.
+    std::vector<int> m_xUv, m_yUv;
+};
+
+} // namespace ts
+
+#endif // __TS_LETTERBOX_H__
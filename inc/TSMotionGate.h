@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2012-2022
+ * All Rights Reserved by Thundercomm Technology Co., Ltd. and its affiliates.
+ * You may not use, copy, distribute, modify, transmit in any form this file
+ * except in compliance with THUNDERCOMM in writing by applicable law.
+ *
+ * @Description: Frame differencing on a luma thumbnail, to skip static frames.
+ * @version: 1.0
+ * @Author: Ricardo Lu<sheng.lu@thundercomm.com>
+ * @Date: 2026-10-17 22:48:31
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-17 22:48:31
+ */
+
+#ifndef __TS_MOTION_GATE_H__
+#define __TS_MOTION_GATE_H__
+
+#include <stdint.h>
+#include <vector>
+
+#include "TSStruct.h"
+
+namespace ts
+{
+
+/**
+ * @brief: Motion detector of one stream.
+ * The monitored area of each frame is shrunk to a luma thumbnail of about 160 pixels
+ * on its longer side, each thumbnail pixel averaging up to 4x4 samples of its block.
+ * It is compared with a reference thumbnail, which is only refreshed where the caller
+ * ran inference, so a slow change keeps accumulating until it is noticed.
+ */
+class TSMotionGate {
+public:
+    /**
+     * @brief: Set the motion thresholds.
+     * @param {int} pixelThresh: Luma difference above which a thumbnail pixel changed, 0-255.
+     * @param {float} minArea: Fraction of the thumbnail which must change to count as motion.
+     */
+    void setThresholds(const int pixelThresh, const float minArea) {
+        m_pixelThresh = pixelThresh;
+        m_minArea = minArea;
+    }
+
+    /**
+     * @brief: Compare an area of the frame with the reference.
+     * @param {ts::TSImgData&} image: RGB, BGR, RGBX, BGRX, NV12, I420 or single channel frame.
+     * @param {TSRect_T<int>&} area: Monitored area, inside the frame.
+     * @param {TSRect_T<int>&} motion: Bounding box of the changed blocks, in image coordinates.
+     * @return {bool} true if the area moved, or if there is no reference for it yet:
+     * motion is then the whole area.
+     */
+    bool detect(const ts::TSImgData& image, const TSRect_T<int>& area, TSRect_T<int>& motion);
+
+    /**
+     * @brief: Make the last thumbnail the reference within a region of the image,
+     * once inference ran on it.
+     * @param {TSRect_T<int>&} region: Inferred region, in image coordinates.
+     */
+    void accept(const TSRect_T<int>& region);
+
+    /**
+     * @brief: Drop the reference, the next frame is seen as moving everywhere.
+     */
+    void reset() {
+        m_valid = false;
+    }
+
+private:
+    void configure(const TSRect_T<int>& area, const int format);
+    void thumbnail(const ts::TSImgData& image);
+
+    int m_pixelThresh = 16;
+    float m_minArea = 0.001f;
+
+    // Cache key of the thumbnail geometry.
+    TSRect_T<int> m_area;
+    int m_format = TYPE_UNKNOWN;
+    // The reference is only valid for that geometry.
+    bool m_valid = false;
+
+    // Each thumbnail pixel covers a m_block x m_block block of the area.
+    int m_block = 1;
+    int m_width = 0;
+    int m_height = 0;
+    // Samples per block side, and their offsets: bytes in a row, rows in the area.
+    int m_samples = 1;
+    std::vector<int> m_xSamples;
+    std::vector<int> m_ySamples;
+    int m_pixelStep = 1;
+    bool m_yuv = false;
+
+    std::vector<uint8_t> m_thumb;
+    std::vector<uint8_t> m_reference;
+};
+
+} // namespace ts
+
+#endif // __TS_MOTION_GATE_H__
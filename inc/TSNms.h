@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2012-2022
+ * All Rights Reserved by Thundercomm Technology Co., Ltd. and its affiliates.
+ * You may not use, copy, distribute, modify, transmit in any form this file
+ * except in compliance with THUNDERCOMM in writing by applicable law.
+ *
+ * @Description: Greedy NMS over a uniform grid spatial index.
+ * @version: 1.0
+ * @Author: Ricardo Lu<sheng.lu@thundercomm.com>
+ * @Date: 2026-10-17 17:05:18
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-17 17:05:18
+ */
+
+#ifndef __TS_NMS_H__
+#define __TS_NMS_H__
+
+#include <vector>
+
+#include "TSDetections.h"
+
+namespace ts
+{
+
+/**
+ * @brief: Greedy NMS giving the same result as comparing every pair with calcIoU.
+ * Kept boxes are registered in the grid cells they cover, a candidate is only
+ * tested against the kept boxes sharing a cell with it: boxes which don't
+ * overlap have a zero IoU and can never suppress each other.
+ * The grid, the sort order and the scratch buffers are reused from frame to frame.
+ */
+class TSNms {
+public:
+    /**
+     * @brief: Only let boxes of the same label suppress each other, false by default.
+     */
+    void setClassAware(const bool classAware) {
+        m_classAware = classAware;
+    }
+
+    /**
+     * @brief: Sort the boxes by descending confidence and drop the suppressed ones in place.
+     * @param {TSDetections&} boxes: Candidates in, kept boxes out.
+     * @param {float} thresh: A box is suppressed if its IoU with a better kept box is above it.
+     * @param {size_t} maxKept: Stop once that many boxes are kept, 0 for no limit.
+     * Boxes are kept in descending confidence, so the result is the head of the unlimited one.
+     */
+    void run(TSDetections& boxes, const float thresh, const size_t maxKept = 0);
+
+    /**
+     * @brief: Counters of the last run().
+     */
+    const NmsStats& stats() const {
+        return m_stats;
+    }
+
+private:
+    void sortByConfidence(TSDetections& boxes);
+    void buildGrid(const TSDetections& boxes, const float thresh);
+    void cellRange(const TSRect_T<int>& box, int& x0, int& y0, int& x1, int& y1) const;
+    bool suppressed(const TSDetections& boxes, const int index, const float thresh);
+
+    bool m_classAware = false;
+    NmsStats m_stats;
+
+    int m_originX = 0;
+    int m_originY = 0;
+    int m_cellSize = 1;
+    int m_cols = 0;
+    int m_rows = 0;
+    // Indexes of the kept boxes covering each cell.
+    std::vector<std::vector<int> > m_cells;
+    // Index of the last candidate tested against each kept box.
+    std::vector<int> m_seen;
+    // Sorting scratch, swapped with the input buffer.
+    std::vector<int> m_order;
+    TSDetections m_sorted;
+};
+
+} // namespace ts
+
+#endif // __TS_NMS_H__
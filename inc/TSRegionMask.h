@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2012-2022
+ * All Rights Reserved by Thundercomm Technology Co., Ltd. and its affiliates.
+ * You may not use, copy, distribute, modify, transmit in any form this file
+ * except in compliance with THUNDERCOMM in writing by applicable law.
+ *
+ * @Description: Polygon include/exclude regions rasterized onto the head grids.
+ * @version: 1.0
+ * @Author: Ricardo Lu<sheng.lu@thundercomm.com>
+ * @Date: 2026-10-17 21:36:05
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-17 21:36:05
+ */
+
+#ifndef __TS_REGION_MASK_H__
+#define __TS_REGION_MASK_H__
+
+#include <stdint.h>
+#include <vector>
+
+#include "TSStruct.h"
+
+namespace ts
+{
+
+typedef std::vector<TSPoint> TSPolygon;
+
+/**
+ * @brief: One byte per grid cell of every head, 1 if the cell is decoded, 0 if skipped.
+ * A cell is decoded if its centre, mapped back to image coordinates, is inside an
+ * include polygon (or there is none) and outside every exclude polygon.
+ * The masks are cached until the polygons, the letterbox geometry or the grids change.
+ */
+class TSRegionMask {
+public:
+    /**
+     * @brief: Set the polygons in image coordinates, even-odd rule, both empty disables the masks.
+     */
+    void setPolygons(const std::vector<TSPolygon>& include, const std::vector<TSPolygon>& exclude);
+
+    bool enabled() const {
+        return !m_include.empty() || !m_exclude.empty();
+    }
+
+    /**
+     * @brief: Rasterize the masks if anything they depend on changed, returns true if so.
+     * @param {TSRect_T<int>&} roi: Cropped region of the frame, empty for the whole frame.
+     * @param {float} scale: Letterbox scale from image to network input pixels.
+     * @param {int} xOffset: Letterbox padding on the left, in network input pixels.
+     * @param {int} yOffset: Letterbox padding on the top, in network input pixels.
+     * @param {std::vector<int>&} heights: Grid height of each head.
+     * @param {std::vector<int>&} widths: Grid width of each head.
+     * @param {std::vector<float>&} strides: Stride of each head.
+     */
+    bool update(const TSRect_T<int>& roi, const float scale, const int xOffset, const int yOffset,
+        const std::vector<int>& heights, const std::vector<int>& widths, const std::vector<float>& strides);
+
+    /**
+     * @brief: Row major mask of a head, null if disabled.
+     */
+    const uint8_t* mask(const size_t head) const {
+        return enabled() && head < m_masks.size() ? m_masks[head].data() : nullptr;
+    }
+
+    /**
+     * @brief: Number of cells of a head left to decode.
+     */
+    size_t activeCells(const size_t head) const;
+
+private:
+    void rasterize(const std::vector<TSPolygon>& polygons, const uint8_t value, const size_t head);
+
+    std::vector<TSPolygon> m_include;
+    std::vector<TSPolygon> m_exclude;
+
+    // Cache key of the masks.
+    bool m_valid = false;
+    TSRect_T<int> m_roi;
+    float m_scale = 0.0f;
+    int m_xOffset = 0;
+    int m_yOffset = 0;
+    std::vector<int> m_heights;
+    std::vector<int> m_widths;
+    std::vector<float> m_strides;
+
+    std::vector<std::vector<uint8_t> > m_masks;
+    // Scanline crossings scratch.
+    std::vector<float> m_crossings;
+};
+
+} // namespace ts
+
+#endif // __TS_REGION_MASK_H__
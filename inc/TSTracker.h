@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2012-2022
+ * All Rights Reserved by Thundercomm Technology Co., Ltd. and its affiliates.
+ * You may not use, copy, distribute, modify, transmit in any form this file
+ * except in compliance with THUNDERCOMM in writing by applicable law.
+ *
+ * @Description: SORT style multi-object tracker: Kalman prediction and greedy IoU association.
+ * @version: 1.0
+ * @Author: Ricardo Lu<sheng.lu@thundercomm.com>
+ * @Date: 2026-10-17 23:37:12
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-17 23:37:12
+ */
+
+#ifndef __TS_TRACKER_H__
+#define __TS_TRACKER_H__
+
+#include <vector>
+
+#include "TSDetections.h"
+
+namespace ts
+{
+
+/**
+ * @brief: Tracks the detections of keyframes and propagates them on the frames in between.
+ * Each box side is filtered by a constant velocity Kalman filter, its centre and size
+ * being independent: x and width with noises proportional to the box width, y and height
+ * to the box height, so the filter behaves the same at any object size.
+ * Detections are matched to the predicted tracks of the same label by decreasing IoU.
+ */
+class TSTracker {
+public:
+    /**
+     * @brief: Set the association and track life cycle parameters.
+     * @param {float} iouThresh: Smallest IoU between a track and the detection it is matched to.
+     * @param {int} maxMisses: Keyframes in a row a track may miss before it is dropped.
+     * @param {int} minHits: Matched keyframes before a track is reported.
+     * @param {float} confidenceDecay: Confidence factor of a track per frame since its last detection.
+     */
+    void setParams(const float iouThresh, const int maxMisses, const int minHits, const float confidenceDecay) {
+        m_iouThresh = iouThresh;
+        m_maxMisses = maxMisses;
+        m_minHits = minHits;
+        m_confidenceDecay = confidenceDecay;
+    }
+
+    /**
+     * @brief: Move every track one frame forward.
+     */
+    void predict();
+
+    /**
+     * @brief: Correct the tracks with the detections of a keyframe, after its predict().
+     * Unmatched detections start new tracks, tracks missing too many keyframes are dropped.
+     * @param {TSDetections&} detections: Boxes of the keyframe, in image coordinates.
+     */
+    void update(const TSDetections& detections);
+
+    /**
+     * @brief: Boxes of the reported tracks: confirmed and matched at the last keyframe.
+     * @param {TSDetections&} boxes: Cleared, then one box per track, its confidence is the
+     * last detection score times confidenceDecay per frame since.
+     * @param {std::vector<int>&} ids: Track id of each box, ids start at 1 and are never reused.
+     */
+    void output(TSDetections& boxes, std::vector<int>& ids) const;
+
+    /**
+     * @brief: Lowest confidence of the reported tracks relative to their detection score,
+     * confidenceDecay per frame since the last detection, 1 if there is none.
+     */
+    float minConfidence() const;
+
+    /**
+     * @brief: Drop every track, the ids keep increasing.
+     */
+    void reset() {
+        m_tracks.clear();
+    }
+
+private:
+    // Position and velocity of one box coordinate, with their covariance.
+    struct Filter {
+        float p = 0.0f;
+        float v = 0.0f;
+        float p00 = 0.0f;
+        float p01 = 0.0f;
+        float p11 = 0.0f;
+
+        void init(const float z, const float scale);
+        void predict(const float scale);
+        void update(const float z, const float scale);
+    };
+
+    struct Track {
+        int id = 0;
+        int label = 0;
+        // Score of the last matched detection, frames since it.
+        float score = 0.0f;
+        int age = 0;
+        int hits = 0;
+        int misses = 0;
+        // Centre x, centre y, width, height.
+        Filter f[4];
+
+        TSRect_T<int> rect() const;
+    };
+
+    float m_iouThresh = 0.3f;
+    int m_maxMisses = 2;
+    int m_minHits = 1;
+    float m_confidenceDecay = 0.95f;
+
+    int m_nextId = 1;
+    std::vector<Track> m_tracks;
+
+    // Association scratch: candidate pairs and the matched flags.
+    struct Pair {
+        float iou;
+        int track;
+        int detection;
+    };
+    std::vector<Pair> m_pairs;
+    std::vector<char> m_trackMatched;
+    std::vector<char> m_detectionMatched;
+};
+
+} // namespace ts
+
+#endif // __TS_TRACKER_H__
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2012-2022
+ * All Rights Reserved by Thundercomm Technology Co., Ltd. and its affiliates.
+ * You may not use, copy, distribute, modify, transmit in any form this file
+ * except in compliance with THUNDERCOMM in writing by applicable law.
+ *
+ * @Description: Sparse decode of yolo output heads with vectorized kernels.
+ * @version: 1.0
+ * @Author: Ricardo Lu<sheng.lu@thundercomm.com>
+ * @Date: 2026-10-17 16:12:40
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-17 16:12:40
+ */
+
+#ifndef __TS_YOLO_DECODE_H__
+#define __TS_YOLO_DECODE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace ts
+{
+
+/**
+ * @brief: One decoded box in network input coordinates.
+ */
+struct YoloCandidate {
+    float cx;
+    float cy;
+    float w;
+    float h;
+    float score;
+    int label;
+};
+
+/**
+ * @brief: One yolo output head, tensor layout [height, width, anchors * channels],
+ * channels are x, y, w, h, objectness then the class scores.
+ */
+struct YoloHead {
+    const float* data = nullptr;
+    int height = 0;
+    int width = 0;
+    int anchors = 3;
+    int channels = 85;
+    // Grid row of data, for a band of rows cut out of a head.
+    int firstRow = 0;
+    float stride = 8;
+    // anchors * (width, height) in network input pixels.
+    const float* anchorGrid = nullptr;
+    // TF8 head used instead of data if not null: real = (q - qoffset) * qstep.
+    const uint8_t* qdata = nullptr;
+    float qstep = 1.0f;
+    int qoffset = 0;
+    // One byte per cell of the rows of data, the anchors of 0 cells are never read. Null decodes all.
+    const uint8_t* cellMask = nullptr;
+};
+
+/**
+ * @brief: Scoring options of the head decode.
+ */
+struct YoloDecodeParams {
+    // Threshold of objectness * class score.
+    float confThresh = 0.5f;
+    // Emit only the highest scoring class of an anchor instead of every class above the threshold.
+    bool bestClassOnly = false;
+    // Allowed labels, empty for all of them. Only these class channels are read.
+    std::vector<int> classes;
+    // Threshold of each allowed label, a negative one uses confThresh.
+    std::vector<float> classThresh;
+};
+
+/**
+ * @brief: Best score of every grid cell of one head, for outputs which don't need boxes.
+ */
+struct YoloScoreMap {
+    int height = 0;
+    int width = 0;
+    float stride = 8;
+    // Highest objectness * class score of the anchors of each cell, 0 if none passed its threshold.
+    std::vector<float> score;
+    // Label of that score, -1 if none.
+    std::vector<int> label;
+};
+
+/**
+ * @brief: Local maximum of the score maps, one per object.
+ */
+struct YoloPeak {
+    // Centre of the cell in network input coordinates.
+    float cx;
+    float cy;
+    float score;
+    int label;
+};
+
+/**
+ * @brief: Building blocks of the head decode for one instruction set.
+ * Every variant gives bit-identical results to the scalar one.
+ */
+struct YoloKernels {
+    const char* name;
+    // Write the indexes of the anchors in [0, count) whose objectness is above thresh.
+    int (*scanObjectness)(const float* pred, int count, int channels, float thresh, int* index);
+    // box[c] = (pred[c] * pred[c] * coef[0][c] + pred[c] * coef[1][c] + coef[2][c]) * coef[3][c]
+    void (*decodeBox)(const float* pred, const float coef[4][4], float* box);
+    // Highest class score, label gets its first index.
+    float (*classMax)(const float* cls, int count, int* label);
+    // Labels and scores of the classes whose objectness * class score is above thresh.
+    int (*classFilter)(const float* cls, int count, float objectness, float thresh,
+        int* labels, float* scores);
+};
+
+/**
+ * @brief: Fastest kernels supported by this CPU, detected once on the first call.
+ */
+const YoloKernels& yoloKernels();
+
+/**
+ * @brief: Every kernel variant supported by this CPU, the scalar reference first.
+ */
+std::vector<const YoloKernels*> yoloKernelsAvailable();
+
+/**
+ * @brief: Append the boxes of one head scoring above the threshold to out.
+ * Only the objectness channel is read for anchors that can't reach the threshold.
+ * @param {YoloKernels&} kernels: Kernel variant to run.
+ * @param {YoloHead&} head: Output head to decode.
+ * @param {YoloDecodeParams&} params: Threshold and scoring mode.
+ * @param {std::vector<YoloCandidate>&} out: Decoded boxes.
+ */
+void decodeYoloHead(const YoloKernels& kernels, const YoloHead& head, const YoloDecodeParams& params,
+    std::vector<YoloCandidate>& out);
+
+/**
+ * @brief: Write the best score and label of each cell of one head into map, no box is decoded.
+ * Uses the same objectness scan and thresholds as decodeYoloHead, in best class only mode.
+ * @param {YoloKernels&} kernels: Kernel variant to run.
+ * @param {YoloHead&} head: Output head or band of rows to score.
+ * @param {YoloDecodeParams&} params: Thresholds.
+ * @param {YoloScoreMap&} map: Map of the whole head, sized by the caller. Only the rows of
+ * the band are written, so the bands of a head can be scored in parallel.
+ */
+void scoreYoloHead(const YoloKernels& kernels, const YoloHead& head, const YoloDecodeParams& params,
+    YoloScoreMap& map);
+
+/**
+ * @brief: Find the cells beating every cell of all the maps within one cell of the
+ * coarser map around them, a cheap replacement of box decoding and NMS to count objects.
+ * @param {std::vector<YoloScoreMap>&} maps: Score maps of the heads.
+ * @param {bool} classAware: Only let cells of the same label suppress each other.
+ * @param {std::vector<YoloPeak>&} peaks: Resulting peaks.
+ */
+void findYoloPeaks(const std::vector<YoloScoreMap>& maps, const bool classAware,
+    std::vector<YoloPeak>& peaks);
+
+/**
+ * @brief: Cut the heads into row bands of about cellsPerBand grid cells each,
+ * decoding the bands in order gives the same candidates as decoding the heads.
+ * @param {std::vector<YoloHead>&} heads: Heads to split.
+ * @param {int} cellsPerBand: Target grid cells of a band.
+ * @param {std::vector<YoloHead>&} bands: Resulting bands.
+ */
+void splitYoloHeads(const std::vector<YoloHead>& heads, const int cellsPerBand,
+    std::vector<YoloHead>& bands);
+
+/**
+ * @brief: Keep the topK highest scoring candidates, in no particular order.
+ * Partial selection with a min-heap of topK entries.
+ * @param {std::vector<YoloCandidate>&} candidates: Candidates in, best topK out.
+ * @param {size_t} topK: Number of candidates to keep, 0 keeps all of them.
+ */
+void keepTopCandidates(std::vector<YoloCandidate>& candidates, const size_t topK);
+
+} // namespace ts
+
+#endif // __TS_YOLO_DECODE_H__
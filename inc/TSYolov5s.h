@@ -35,10 +35,186 @@ public:
     float confidence = -1.0f;
     // The label of this Bounding box
     int label = -1;
+    // Id of the track of this object, stable across frames, -1 without tracker
+    int track_id = -1;
     // Time cost of detecting this frame
     size_t time_cost = 0;
 };
 
+/**
+ * @brief: Zero-copy view of the detections of a frame, one array per field.
+ * Owned by the TSObjectDetection instance and valid until its next Detect call.
+ */
+struct DetectionView {
+    size_t size = 0;
+    const int* x = nullptr;
+    const int* y = nullptr;
+    const int* width = nullptr;
+    const int* height = nullptr;
+    const float* confidence = nullptr;
+    const int* label = nullptr;
+    // Track ids, null without tracker
+    const int* trackId = nullptr;
+
+    /**
+     * @brief: Append the detections to an ObjectData vector.
+     * @param {std::vector<ObjectData>&} results: Detections are appended to it.
+     */
+    void toObjectData(std::vector<ObjectData>& results) const;
+};
+
+/**
+ * @brief: Coarse objectness density of a frame, row major.
+ * Cell (row, col) covers the image rectangle (x + col * cellWidth, y + row * cellHeight,
+ * cellWidth, cellHeight), the grid also spans the letterbox padding around the image.
+ */
+struct DensityMap {
+    int rows = 0;
+    int cols = 0;
+    float x = 0.0f;
+    float y = 0.0f;
+    float cellWidth = 0.0f;
+    float cellHeight = 0.0f;
+    // Highest detection score within each cell, 0 where nothing passed the thresholds.
+    std::vector<float> value;
+};
+
+/**
+ * @brief: NMS counters of the last detected frame, for profiling.
+ */
+struct NmsStats {
+    // Boxes entering NMS
+    size_t candidates = 0;
+    // Boxes left after NMS
+    size_t kept = 0;
+    // IoU computed, candidates * (candidates - 1) / 2 for an all pairs NMS
+    size_t comparisons = 0;
+};
+
+/**
+ * @brief: Motion gating of Detect, to save inference on static scenes.
+ */
+struct MotionGateParams {
+    // Frames in a row allowed to reuse old results, skipped or cropped, before the
+    // whole ROI is detected again. It bounds the skip ratio to maxSkip / (maxSkip + 1).
+    // 0 (default) disables the motion gate.
+    int maxSkip = 0;
+    // Luma difference of a thumbnail pixel counted as motion, 0-255.
+    int pixelThresh = 16;
+    // Fraction of the thumbnail which must change, below it the frame is skipped.
+    float minArea = 0.001f;
+    // Margin around the moving area, in image pixels.
+    int padding = 32;
+    // Largest cropped region as a fraction of the ROI, the whole ROI is detected above it.
+    // 0 never crops.
+    float maxCropArea = 0.5f;
+};
+
+/**
+ * @brief: Motion gate counters since the gate was set.
+ */
+struct MotionStats {
+    // Frames given to Detect
+    size_t frames = 0;
+    // Frames returning the previous results without inference
+    size_t skipped = 0;
+    // Frames only detected around the moving area
+    size_t cropped = 0;
+    // Frames detected on the whole ROI
+    size_t full = 0;
+};
+
+/**
+ * @brief: Tracking of the detections, to only run the detector on keyframes.
+ */
+struct TrackerParams {
+    // Detect every detectInterval frames, the tracks are propagated in between.
+    // 0 (default) disables the tracker, 1 detects every frame and adds the track ids.
+    int detectInterval = 0;
+    // Detect before the interval once a track confidence relative to its last
+    // detection falls below it, 0 never does.
+    float minConfidence = 0.0f;
+    // Confidence factor of a track per frame since its last detection.
+    float confidenceDecay = 0.95f;
+    // Smallest IoU between a predicted track and the detection it is matched to.
+    float iouThresh = 0.3f;
+    // Keyframes in a row a track may miss before it is dropped.
+    int maxMisses = 2;
+    // Matched keyframes before a track is reported.
+    int minHits = 1;
+};
+
+/**
+ * @brief: Tracker counters since the tracker was set.
+ */
+struct TrackerStats {
+    // Frames given to Detect
+    size_t frames = 0;
+    // Frames which ran the detector
+    size_t keyframes = 0;
+};
+
+/**
+ * @brief: Tiled detection, for small objects in frames much larger than the model input.
+ */
+struct TilingParams {
+    // Tile size in pixels, 0 (default) disables tiling: the frame is letterboxed
+    // as a whole. A tile larger than the frame or the ROI is clamped to it.
+    int tileWidth = 0;
+    int tileHeight = 0;
+    // Overlap of neighbouring tiles, objects up to this size always fit in one tile.
+    int overlap = 64;
+    // Tiles per row and column, 0 derives them from the size and the overlap.
+    int cols = 0;
+    int rows = 0;
+    // Also detect on the whole frame downscaled, for the objects larger than a tile.
+    bool fullFrame = false;
+};
+
+/**
+ * @brief: Foveated second pass: full resolution crops around the uncertain or small
+ * boxes of the letterboxed detection.
+ */
+struct FoveaParams {
+    // Crops detected per frame at most, it bounds the cost of the second pass.
+    // 0 (default) disables it.
+    int maxCrops = 0;
+    // Boxes of the first pass scoring below it are refined.
+    float refineThresh = 0.7f;
+    // The first pass keeps boxes down to this score, below the score threshold:
+    // they are only reported if a crop confirms them.
+    float candidateThresh = 0.25f;
+    // Boxes whose longer side is below this many model input pixels are refined.
+    int smallSize = 16;
+};
+
+/**
+ * @brief: Second pass counters since it was set.
+ */
+struct FoveaStats {
+    // Frames given to the second pass
+    size_t frames = 0;
+    // Boxes of the first pass to refine
+    size_t candidates = 0;
+    // Crops detected
+    size_t crops = 0;
+};
+
+/**
+ * @brief: Engine pool counters since it was built, shared by all its detectors.
+ */
+struct EngineStats {
+    // Engines of the pool
+    int engines = 0;
+    // Engines acquired, one per detected frame, batch or count
+    size_t acquires = 0;
+    // Acquisitions which found every engine busy or other callers waiting
+    size_t waited = 0;
+    // Acquisitions by wait for an idle engine, bucket 0 counts the waits under 1 us,
+    // bucket i those in [2^(i-1), 2^i) us and the last one everything above
+    std::vector<size_t> waits;
+};
+
 /**
  * @brief: Object detection instance object.
  */
@@ -69,6 +245,87 @@ public:
      */    
     bool Init(const std::string& model_path, const runtime_t runtime);
 
+    /**
+     * @brief: Init on the engines of another initialized instance instead of building its own.
+     * The model, runtime, input size, batch, encodings and output heads are those of the
+     * other instance, the other settings are this instance's own. Up to the engine count
+     * of the pool, the instances sharing it detect concurrently from their own threads,
+     * each instance still being used by one thread at a time.
+     * @Author: Ricardo Lu
+     * @param {ts::TSObjectDetection&} other: Initialized instance owning or sharing the engines.
+     * @return {bool} true if init successfully, false if failed.
+     */
+    bool InitShared(const TSObjectDetection& other);
+
+    /**
+     * @brief: Set the number of SNPE engines built by Init, must be called before Init.
+     * The model is loaded once and each engine gets its own input and output buffers,
+     * so that several instances given to InitShared() run inference concurrently.
+     * @Author: Ricardo Lu
+     * @param {int} count: Number of engines, 1 by default.
+     * @return {bool} true if setter successfully, false if failed.
+     */
+    bool SetEngineCount(const int count);
+
+    /**
+     * @brief: Get the engine pool counters, the wait histogram helps sizing the pool.
+     * @Author: Ricardo Lu
+     * @param {ts::EngineStats&} stats: Engines, acquisitions and waits of all the instances of the pool.
+     * @return {bool} true if getter successfully, false if failed.
+     */
+    bool GetEngineStats(ts::EngineStats& stats);
+
+    /**
+     * @brief: Only detect objects of a given size, must be called before Init.
+     * Sizes are the longer box side in model input pixels. The output heads which
+     * can't predict such sizes are neither computed by the runtime nor decoded.
+     * @Author: Ricardo Lu
+     * @param {int} min_size: Smallest kept size, 0 for no limit.
+     * @param {int} max_size: Largest kept size, 0 for no limit.
+     * @return {bool} true if setter successfully, false if failed.
+     */
+    bool SetObjectSize(const int min_size, const int max_size);
+
+    /**
+     * @brief: Resize the model input, must be called before Init.
+     * Matching the aspect ratio of the camera avoids convolving over letterbox padding,
+     * e.g. 640x384 for 16:9 frames instead of the 640x640 of the model.
+     * @Author: Ricardo Lu
+     * @param {int} width: Input width, a multiple of 32.
+     * @param {int} height: Input height, a multiple of 32. 0x0 keeps the model input size.
+     * @return {bool} true if setter successfully, false if failed.
+     */
+    bool SetInputSize(const int width, const int height);
+
+    /**
+     * @brief: Set the batch size of the resized model input, must be called before Init.
+     * Without SetInputSize() the model keeps the batch it was converted with.
+     * @Author: Ricardo Lu
+     * @param {int} batch: Frames per inference, 0 for 1 (default).
+     * @return {bool} true if setter successfully, false if failed.
+     */
+    bool SetBatchSize(const int batch);
+
+    /**
+     * @brief: Select the encoding of the model input buffer, must be called before Init.
+     * The frame is letterboxed straight into that encoding: ENCODING_TF8 uses the input
+     * quantization of the model, ENCODING_FP16 suits the GPU_16 runtime.
+     * @Author: Ricardo Lu
+     * @param {encoding_t} encoding: ENCODING_FLOAT (default), ENCODING_TF8 or ENCODING_FP16.
+     * @return {bool} true if setter successfully, false if failed.
+     */
+    bool SetInputEncoding(const encoding_t encoding);
+
+    /**
+     * @brief: Select the encoding of the model output buffers, must be called before Init.
+     * With ENCODING_TF8 the DSP/AIP runtimes don't dequantize the outputs: objectness is
+     * thresholded on the uint8 codes and only the surviving anchors are dequantized.
+     * @Author: Ricardo Lu
+     * @param {encoding_t} encoding: ENCODING_FLOAT (default) or ENCODING_TF8.
+     * @return {bool} true if setter successfully, false if failed.
+     */
+    bool SetOutputEncoding(const encoding_t encoding);
+
     /**
      * @brief: Release relevant resources.
      * @Author: Ricardo Lu
@@ -97,15 +354,224 @@ public:
      */    
     bool SetROI(const ts::TSRect_T<int>& roi);
 
+    /**
+     * @brief: Detect on several regions of interest with a single inference. The regions
+     * are scaled by the same factor and shelf packed into the model input, each one
+     * letterboxed in its own cell, then the boxes are mapped back to their region and
+     * the ones crossing a cell border are dropped. The packing is cached until the
+     * regions or the frame size change. It replaces SetROI(), tiling and the second
+     * pass, and the polygon regions are not applied to it.
+     * @Author: Ricardo Lu
+     * @param {std::vector<ts::TSRect_T<int> >&} rois: Regions in image coordinates, empty disables it.
+     * @return {bool} true if setter successfully, false if failed.
+     */
+    bool SetROIs(const std::vector<ts::TSRect_T<int> >& rois);
+
+    /**
+     * @brief: Restrict detection to polygon regions, in image coordinates.
+     * The polygons are rasterized onto the grid cells of every head, the cells whose
+     * centre is outside the include polygons (if any) or inside an exclude polygon
+     * are not decoded at all. The masks are rebuilt when the ROI or frame size changes.
+     * @Author: Ricardo Lu
+     * @param {std::vector<std::vector<ts::TSPoint> >&} include: Regions to detect in, empty for the whole frame.
+     * @param {std::vector<std::vector<ts::TSPoint> >&} exclude: Regions to ignore.
+     * @return {bool} true if setter successfully, false if failed.
+     */
+    bool SetRegions(const std::vector<std::vector<ts::TSPoint> >& include,
+        const std::vector<std::vector<ts::TSPoint> >& exclude);
+
+    /**
+     * @brief: Select the interpolation used to resize frames into the model input.
+     * INTERP_NEAREST is the fastest, INTERP_AREA gives the best quality when shrinking large frames.
+     * @Author: Ricardo Lu
+     * @param {interp_t} interp: Resize interpolation, INTERP_LINEAR by default.
+     * @return {bool} true if setter successfully, false if failed.
+     */
+    bool SetInterpolation(const interp_t interp);
+
+    /**
+     * @brief: Split preprocessing into horizontal bands over several threads, for large frames like 4K.
+     * The result is bit-identical to the single-threaded one.
+     * @Author: Ricardo Lu
+     * @param {int} threads: Number of threads including the caller, 1 by default.
+     * @return {bool} true if setter successfully, false if failed.
+     */
+    bool SetPreProcessThreads(const int threads);
+
+    /**
+     * @brief: Decode the output heads on several threads, cut into row bands of similar size.
+     * The result is identical to the single-threaded one.
+     * @Author: Ricardo Lu
+     * @param {int} threads: Number of threads including the caller, 1 by default.
+     * @return {bool} true if setter successfully, false if failed.
+     */
+    bool SetPostProcessThreads(const int threads);
+
+    /**
+     * @brief: Bound the work spent on noisy frames.
+     * Only the top_k best scoring candidates enter NMS, and NMS stops once max_detections boxes are kept.
+     * Boxes out of the SetObjectSize() range are dropped before the top_k cut, they never
+     * take the place of a box in range.
+     * @Author: Ricardo Lu
+     * @param {int} top_k: Candidates kept before NMS, 0 (default) for no limit.
+     * @param {int} max_detections: Detections returned per frame at most, 0 (default) for no limit.
+     * @return {bool} true if setter successfully, false if failed.
+     */
+    bool SetDetectionLimits(const int top_k, const int max_detections);
+
+    /**
+     * @brief: Score each anchor with its best class only, instead of one box per class above the threshold.
+     * @Author: Ricardo Lu
+     * @param {bool} best_class_only: false by default.
+     * @return {bool} true if setter successfully, false if failed.
+     */
+    bool SetBestClassOnly(const bool best_class_only);
+
+    /**
+     * @brief: Only detect some labels, the class scores of the other labels are not even read.
+     * @Author: Ricardo Lu
+     * @param {std::vector<int>&} classes: Allowed label ids, empty (default) to detect all of them.
+     * @param {std::vector<float>&} conf_thresh: Confidence threshold of each allowed label,
+     * a negative one or an empty vector uses the threshold of SetScoreThreshold.
+     * @return {bool} true if setter successfully, false if failed.
+     */
+    bool SetClasses(const std::vector<int>& classes, const std::vector<float>& conf_thresh = {});
+
+    /**
+     * @brief: Only let boxes of the same label suppress each other in NMS.
+     * By default NMS is class agnostic: any better box suppresses an overlapping one.
+     * @Author: Ricardo Lu
+     * @param {bool} class_aware: true for per-class NMS, false by default.
+     * @return {bool} true if setter successfully, false if failed.
+     */
+    bool SetClassAwareNMS(const bool class_aware);
+
+    /**
+     * @brief: Skip inference on static frames, and only detect around the moving area otherwise.
+     * A luma thumbnail of the ROI is compared with the one of the last inferred frame:
+     * without motion Detect returns the previous results, with localized motion only a
+     * padded region around it goes through the ROI path, the previous boxes elsewhere are kept.
+     * The crop is never smaller than the model input, so objects are not upscaled. Count is not gated.
+     * @Author: Ricardo Lu
+     * @param {ts::MotionGateParams&} params: Thresholds, maxSkip 0 disables the gate.
+     * @return {bool} true if setter successfully, false if failed.
+     */
+    bool SetMotionGate(const ts::MotionGateParams& params);
+
+    /**
+     * @brief: Get the motion gate counters.
+     * @Author: Ricardo Lu
+     * @param {ts::MotionStats&} stats: Frames skipped, cropped and fully detected.
+     * @return {bool} true if getter successfully, false if failed.
+     */
+    bool GetMotionStats(ts::MotionStats& stats);
+
+    /**
+     * @brief: Track the detections and only run the detector on keyframes.
+     * Tracks are predicted by a constant velocity Kalman filter and matched to the
+     * detections of each keyframe by IoU, the frames in between only return the
+     * predicted boxes. The track ids are reported in ObjectData::track_id and
+     * DetectionView::trackId. Keyframes go through the motion gate if it is set.
+     * @Author: Ricardo Lu
+     * @param {ts::TrackerParams&} params: Keyframe interval and track life cycle, detectInterval 0 disables it.
+     * @return {bool} true if setter successfully, false if failed.
+     */
+    bool SetTracker(const ts::TrackerParams& params);
+
+    /**
+     * @brief: Get the tracker counters.
+     * @Author: Ricardo Lu
+     * @param {ts::TrackerStats&} stats: Frames and keyframes.
+     * @return {bool} true if getter successfully, false if failed.
+     */
+    bool GetTrackerStats(ts::TrackerStats& stats);
+
+    /**
+     * @brief: Detect on tiles of the frame instead of its letterbox, for small objects
+     * in large frames. The tiles are inferred in batches of the model batch size, each
+     * one decoded in place, then the boxes cut by a tile seam are dropped and a single
+     * NMS runs over all tiles. Count() and the motion gate crops are not tiled.
+     * @Author: Ricardo Lu
+     * @param {ts::TilingParams&} params: Tile size and overlap, tileWidth or tileHeight 0 disables it.
+     * @return {bool} true if setter successfully, false if failed.
+     */
+    bool SetTiling(const ts::TilingParams& params);
+
+    /**
+     * @brief: Refine the letterboxed detection with a second pass on full resolution crops.
+     * The crops have the model input size and are centred on the uncertain or small boxes
+     * of the first pass, by decreasing score, up to the crop budget. The first pass boxes
+     * a crop sees whole are replaced by its detections. Not used with tiling.
+     * @Author: Ricardo Lu
+     * @param {ts::FoveaParams&} params: Crop budget and candidate selection, maxCrops 0 disables it.
+     * @return {bool} true if setter successfully, false if failed.
+     */
+    bool SetFovea(const ts::FoveaParams& params);
+
+    /**
+     * @brief: Get the second pass counters.
+     * @Author: Ricardo Lu
+     * @param {ts::FoveaStats&} stats: Frames, candidates and crops.
+     * @return {bool} true if getter successfully, false if failed.
+     */
+    bool GetFoveaStats(ts::FoveaStats& stats);
+
+    /**
+     * @brief: Get the NMS counters of the last detected frame.
+     * @Author: Ricardo Lu
+     * @param {ts::NmsStats&} stats: Candidates, kept boxes and IoU computed.
+     * @return {bool} true if getter successfully, false if failed.
+     */
+    bool GetNMSStats(ts::NmsStats& stats);
+
     /**
      * @brief: Core method of object detection.
      * @Author: Ricardo Lu
-     * @param {ts::TSImgData&} image: A RGB format image needs to be detected.
+     * @param {ts::TSImgData&} image: A RGB/BGR/RGBX/BGRX/NV12/I420 format image needs to be detected.
      * @param {std::vector<std::vector<ts::ObjectData> >&} results: Detection results vector for each image.
      * @return {bool} true if detect successfullly, false if failed.
      */
     bool Detect(const ts::TSImgData& image, std::vector<ts::ObjectData>& results);
 
+    /**
+     * @brief: Object detection without any copy of the results.
+     * @Author: Ricardo Lu
+     * @param {ts::TSImgData&} image: A RGB/BGR/RGBX/BGRX/NV12/I420 format image needs to be detected.
+     * @param {ts::DetectionView&} detections: View of the detections, valid until the next Detect call.
+     * @return {bool} true if detect successfullly, false if failed.
+     */
+    bool Detect(const ts::TSImgData& image, ts::DetectionView& detections);
+
+    /**
+     * @brief: Detect several frames with one inference per batch of the model.
+     * Each frame is letterboxed into its own slice of the input tensor and each slice
+     * of the output heads is decoded with the geometry of its frame. The frames are
+     * independent, e.g. from different cameras. Applied to each of them: SetROI, SetRegions,
+     * the score, class and object size filters, the detection limits and NMS.
+     * Ignored: SetROIs (mosaic), SetTiling, SetFovea (second pass), SetMotionGate and
+     * SetTracker, which need the frames of one stream in order.
+     * @Author: Ricardo Lu
+     * @param {std::vector<ts::TSImgData>&} images: RGB/BGR/RGBX/BGRX/NV12/I420 format images,
+     * any number of them, a last partial batch still costs a whole inference.
+     * @param {std::vector<std::vector<ts::ObjectData> >&} results: Detection results vector for each image.
+     * @return {bool} true if detect successfullly, false if failed.
+     */
+    bool Detect(const std::vector<ts::TSImgData>& images, std::vector<std::vector<ts::ObjectData> >& results);
+
+    /**
+     * @brief: Count the objects of each class without building any box.
+     * Objects are the local maxima of the per cell scores of the output heads,
+     * no box is decoded and no NMS runs, so crowded scenes may be under counted.
+     * The thresholds, classes, class aware mode and output heads of Detect apply,
+     * the size and detection limits don't.
+     * @Author: Ricardo Lu
+     * @param {ts::TSImgData&} image: A RGB/BGR/RGBX/BGRX/NV12/I420 format image needs to be counted.
+     * @param {std::vector<int>&} counts: Number of objects of each label, resized to the class number.
+     * @param {ts::DensityMap*} density: Density grid at the coarsest head stride, skipped if null.
+     * @return {bool} true if count successfullly, false if failed.
+     */
+    bool Count(const ts::TSImgData& image, std::vector<int>& counts, ts::DensityMap* density = nullptr);
+
     /**
      * @brief: Check object detection instance initialization state.
      * @Author: Ricardo Lu
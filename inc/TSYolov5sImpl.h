@@ -22,9 +22,15 @@
 
 #include "SNPETask.h"
 #include "TSYolov5s.h"
+#include "TSLetterbox.h"
+#include "TSYoloDecode.h"
+#include "TSNms.h"
+#include "TSRegionMask.h"
+#include "TSMotionGate.h"
+#include "TSTracker.h"
+#include "TSEnginePool.h"
 
 #define MODEL_OUTPUT_CHANNEL    85
-#define MODEL_OUTPUT_GRIDS      25200    // (80 * 80 + 40 * 40 + 20 * 20) * 3
 
 #define INPUT_TENSOR            "images"
 #define OUTPUT_NODE0            "Sigmoid_199"
@@ -34,17 +40,33 @@
 #define OUTPUT_TENSOR1          "329"
 #define OUTPUT_TENSOR2          "331"
 
+#define MODEL_HEADS             3
+
+// Output layer, output tensor, stride and anchors (width, height) of the 3 output heads.
+static const char* const MODEL_OUTPUT_NODES[MODEL_HEADS] = {OUTPUT_NODE0, OUTPUT_NODE1, OUTPUT_NODE2};
+static const char* const MODEL_OUTPUT_TENSORS[MODEL_HEADS] = {OUTPUT_TENSOR0, OUTPUT_TENSOR1, OUTPUT_TENSOR2};
+static const float MODEL_STRIDES[MODEL_HEADS] = {8, 16, 32};
+static const float MODEL_ANCHORS[MODEL_HEADS][6] = {
+    {10, 13, 16, 30, 33, 23},       // 8*8
+    {30, 61, 62, 45, 59, 119},      // 16*16
+    {116, 90, 156, 198, 373, 326},  // 32*32
+};
+
 class TSObjectDetectionImpl {
 public:
     TSObjectDetectionImpl();
     ~TSObjectDetectionImpl();
     bool Detect(const ts::TSImgData& image, std::vector<ts::ObjectData>& results);
+    bool Detect(const ts::TSImgData& image, ts::DetectionView& detections);
+    bool Detect(const std::vector<ts::TSImgData>& images, std::vector<std::vector<ts::ObjectData> >& results);
+    bool Count(const ts::TSImgData& image, std::vector<int>& counts, ts::DensityMap* density);
     bool Initialize(const std::string& model_path, const runtime_t runtime);
+    bool InitializeShared(const TSObjectDetectionImpl& other);
     bool DeInitialize();
 
     bool SetScoreThresh(const float& conf_thresh, const float& nms_thresh = 0.5) noexcept {
         this->m_nmsThresh  = nms_thresh;
-        this->m_confThresh = conf_thresh;
+        this->m_decodeParams.confThresh = conf_thresh;
         return true;
     }
 
@@ -53,67 +75,439 @@ public:
         return true;
     }
 
-    bool IsInitialized() const {
-        return m_isInit;
+    bool SetROIs(const std::vector<ts::TSRect_T<int> >& rois) {
+        for (const auto& roi : rois) {
+            if (roi.x < 0 || roi.y < 0 || roi.width <= 0 || roi.height <= 0) {
+                TS_ERROR_LOG("Invalid ROI (%d, %d, %d, %d)!", roi.x, roi.y, roi.width, roi.height);
+                return false;
+            }
+        }
+        m_mosaicRois = rois;
+        // The packing is rebuilt on the next frame.
+        m_mosaicCells.clear();
+        return true;
+    }
+
+    bool SetRegions(const std::vector<ts::TSPolygon>& include, const std::vector<ts::TSPolygon>& exclude) {
+        m_includeRegions = include;
+        m_excludeRegions = exclude;
+        for (auto& mask : m_regionMasks) {
+            mask.setPolygons(include, exclude);
+        }
+        m_regionMaskGrids.clear();
+        return true;
+    }
+
+    bool SetObjectSize(const int minSize, const int maxSize) {
+        if (m_isInit) {
+            TS_ERROR_LOG("Object size must be set before initialization!");
+            return false;
+        }
+        if (minSize < 0 || maxSize < 0 || (maxSize > 0 && maxSize < minSize)) {
+            TS_ERROR_LOG("Invalid object size range [%d, %d]!", minSize, maxSize);
+            return false;
+        }
+        m_minSize = minSize;
+        m_maxSize = maxSize;
+        return true;
+    }
+
+    bool SetInputSize(const int width, const int height) {
+        if (m_isInit) {
+            TS_ERROR_LOG("Input size must be set before initialization!");
+            return false;
+        }
+        // 0x0 keeps the model size, otherwise every head needs a whole grid.
+        const int stride = static_cast<int>(MODEL_STRIDES[2]);
+        if (!(0 == width && 0 == height) &&
+            (width <= 0 || height <= 0 || width % stride || height % stride)) {
+            TS_ERROR_LOG("Invalid input size %dx%d, expected multiples of %d!", width, height, stride);
+            return false;
+        }
+        m_inputWidth = width;
+        m_inputHeight = height;
+        return true;
+    }
+
+    bool SetBatchSize(const int batch) {
+        if (m_isInit) {
+            TS_ERROR_LOG("Batch size must be set before initialization!");
+            return false;
+        }
+        if (batch < 0) {
+            TS_ERROR_LOG("Invalid batch size %d!", batch);
+            return false;
+        }
+        m_batchSize = batch;
+        return true;
     }
 
-    static std::vector<ts::ObjectData> nms(std::vector<ts::ObjectData> winList, const float& nms_thresh) {
-        if (winList.empty()) {
-            return winList;
+    bool SetEngineCount(const int count) {
+        if (m_isInit) {
+            TS_ERROR_LOG("Engine count must be set before initialization!");
+            return false;
         }
+        if (count < 1) {
+            TS_ERROR_LOG("Invalid engine count %d!", count);
+            return false;
+        }
+        m_engineCount = count;
+        return true;
+    }
+
+    bool GetEngineStats(ts::EngineStats& stats) const {
+        m_engines->stats(stats);
+        return true;
+    }
+
+    bool SetInputEncoding(const encoding_t encoding) {
+        if (m_isInit) {
+            TS_ERROR_LOG("Input encoding must be set before initialization!");
+            return false;
+        }
+        if (ENCODING_FLOAT != encoding && ENCODING_TF8 != encoding && ENCODING_FP16 != encoding) {
+            TS_ERROR_LOG("Unsupported input encoding %d!", encoding);
+            return false;
+        }
+        m_inputEncoding = encoding;
+        return true;
+    }
+
+    bool SetOutputEncoding(const encoding_t encoding) {
+        if (m_isInit) {
+            TS_ERROR_LOG("Output encoding must be set before initialization!");
+            return false;
+        }
+        if (ENCODING_FLOAT != encoding && ENCODING_TF8 != encoding) {
+            TS_ERROR_LOG("Unsupported output encoding %d!", encoding);
+            return false;
+        }
+        m_outputEncoding = encoding;
+        return true;
+    }
+
+    bool SetInterpolation(const interp_t interp) {
+        m_interp = interp;
+        for (auto& letterbox : m_letterboxes) {
+            letterbox.setInterpolation(interp);
+        }
+        for (auto& letterbox : m_mosaicLetterboxes) {
+            letterbox.setInterpolation(interp);
+        }
+        return true;
+    }
 
-        std::sort(winList.begin(), winList.end(), [] (const ts::ObjectData& left, const ts::ObjectData& right) {
-            if (left.confidence > right.confidence) {
-                return true;
-            } else {
+    bool SetPreProcessThreads(const int threads) {
+        if (threads < 1) {
+            TS_ERROR_LOG("Invalid preprocess thread number %d!", threads);
+            return false;
+        }
+        m_preProcessPool.resize(threads);
+        return true;
+    }
+
+    bool SetPostProcessThreads(const int threads) {
+        if (threads < 1) {
+            TS_ERROR_LOG("Invalid postprocess thread number %d!", threads);
+            return false;
+        }
+        m_postProcessPool.resize(threads);
+        return true;
+    }
+
+    bool SetTopK(const int topK) {
+        if (topK < 0) {
+            TS_ERROR_LOG("Invalid top-k %d!", topK);
+            return false;
+        }
+        m_topK = topK;
+        return true;
+    }
+
+    bool SetMaxDetections(const int maxDetections) {
+        if (maxDetections < 0) {
+            TS_ERROR_LOG("Invalid max detections %d!", maxDetections);
+            return false;
+        }
+        m_maxDetections = maxDetections;
+        return true;
+    }
+
+    bool SetBestClassOnly(const bool bestClassOnly) {
+        m_decodeParams.bestClassOnly = bestClassOnly;
+        return true;
+    }
+
+    bool SetClasses(const std::vector<int>& classes, const std::vector<float>& confThresh) {
+        if (!confThresh.empty() && confThresh.size() != classes.size()) {
+            TS_ERROR_LOG("%ld class thresholds given for %ld classes!", confThresh.size(), classes.size());
+            return false;
+        }
+        for (int label : classes) {
+            if (label < 0 || label >= MODEL_OUTPUT_CHANNEL - 5) {
+                TS_ERROR_LOG("Invalid class %d!", label);
                 return false;
             }
-        });
+        }
+        m_decodeParams.classes = classes;
+        m_decodeParams.classThresh = confThresh;
+        m_decodeParams.classThresh.resize(classes.size(), -1.0f);
+        return true;
+    }
 
-        std::vector<bool> flag(winList.size(), false);
-        for (int i = 0; i < winList.size(); i++) {
-            if (flag[i]) {
-                continue;
-            }
+    bool SetClassAwareNMS(const bool classAware) {
+        m_classAware = classAware;
+        m_nms.setClassAware(classAware);
+        return true;
+    }
 
-            for (int j = i + 1; j < winList.size(); j++) {
-                if (ts::calcIoU(
-                        reinterpret_cast<const ts::TSRect_T<int>*>(&winList[i]),
-                        reinterpret_cast<const ts::TSRect_T<int>*>(&winList[j])) > nms_thresh) {
-                    flag[j] = true;
-                }
-            }
+    bool SetMotionGate(const ts::MotionGateParams& params) {
+        if (params.maxSkip < 0 || params.pixelThresh < 0 || params.pixelThresh > 255 ||
+            params.minArea < 0.0f || params.minArea > 1.0f || params.padding < 0 ||
+            params.maxCropArea < 0.0f || params.maxCropArea > 1.0f) {
+            TS_ERROR_LOG("Invalid motion gate parameters!");
+            return false;
         }
+        m_motionParams = params;
+        m_motionGate.setThresholds(params.pixelThresh, params.minArea);
+        m_motionGate.reset();
+        m_motionStats = ts::MotionStats();
+        m_motionFrames = 0;
+        return true;
+    }
+
+    bool GetMotionStats(ts::MotionStats& stats) const {
+        stats = m_motionStats;
+        return true;
+    }
 
-        std::vector<ts::ObjectData> ret;
-        for (int i = 0; i < winList.size(); i++) {
-            if (!flag[i])
-                ret.push_back(winList[i]);
+    bool SetTiling(const ts::TilingParams& params) {
+        // A single size set makes square tiles.
+        const int width = params.tileWidth > 0 ? params.tileWidth : params.tileHeight;
+        const int height = params.tileHeight > 0 ? params.tileHeight : params.tileWidth;
+        if (params.tileWidth < 0 || params.tileHeight < 0 || params.overlap < 0 ||
+            params.cols < 0 || params.rows < 0 || (width > 0 &&
+            (width <= params.overlap || height <= params.overlap))) {
+            TS_ERROR_LOG("Invalid tiling parameters!");
+            return false;
         }
+        m_tilingParams = params;
+        // The layout is rebuilt on the next frame.
+        m_tileArea = ts::TSRect_T<int>(0, 0, 0, 0);
+        return true;
+    }
 
-        return ret;
+    bool SetFovea(const ts::FoveaParams& params) {
+        if (params.maxCrops < 0 || params.refineThresh < 0.0f || params.refineThresh > 1.0f ||
+            params.candidateThresh < 0.0f || params.candidateThresh > 1.0f || params.smallSize < 0) {
+            TS_ERROR_LOG("Invalid fovea parameters!");
+            return false;
+        }
+        m_foveaParams = params;
+        m_foveaStats = ts::FoveaStats();
+        return true;
+    }
+
+    bool GetFoveaStats(ts::FoveaStats& stats) const {
+        stats = m_foveaStats;
+        return true;
+    }
+
+    bool SetTracker(const ts::TrackerParams& params) {
+        if (params.detectInterval < 0 || params.minConfidence < 0.0f || params.minConfidence > 1.0f ||
+            params.confidenceDecay <= 0.0f || params.confidenceDecay > 1.0f ||
+            params.iouThresh < 0.0f || params.iouThresh > 1.0f || params.maxMisses < 0 || params.minHits < 1) {
+            TS_ERROR_LOG("Invalid tracker parameters!");
+            return false;
+        }
+        m_trackerParams = params;
+        m_tracker.setParams(params.iouThresh, params.maxMisses, params.minHits, params.confidenceDecay);
+        m_tracker.reset();
+        m_trackerStats = ts::TrackerStats();
+        // The next frame is a keyframe.
+        m_framesSinceKeyframe = params.detectInterval;
+        return true;
+    }
+
+    bool GetTrackerStats(ts::TrackerStats& stats) const {
+        stats = m_trackerStats;
+        return true;
+    }
+
+    bool GetNMSStats(ts::NmsStats& stats) const {
+        stats = m_nms.stats();
+        return true;
     }
 
+    bool IsInitialized() const {
+        return m_isInit;
+    }
+
+    // One region of the mosaic: its source in the frame, the window it is scaled into
+    // and the cell around it, whose rest is gray padding.
+    struct MosaicCell {
+        ts::TSRect_T<int> roi;
+        ts::TSRect_T<int> window;
+        ts::TSRect_T<int> cell;
+    };
+
+    // Pack the regions into the input at the largest scale shared by all of them. The windows
+    // are the regions at that scale, at least gap pixels apart, and the cells cover the input.
+    // Returns the scale, 0 with no cell if they don't fit.
+    static float PackMosaic(const std::vector<ts::TSRect_T<int> >& rois, const int inputWidth,
+        const int inputHeight, const int gap, std::vector<MosaicCell>& cells);
+
 private:
     bool m_isInit = false;
 
-    bool PreProcess(const ts::TSImgData& frame);
-    bool PostProcess(std::vector<ts::ObjectData>& results);
+    enum MotionDecision {
+        MOTION_SKIP,    // reuse the previous results
+        MOTION_CROP,    // detect around the moving area only
+        MOTION_FULL     // detect the whole ROI
+    };
+
+    // Region of the frame letterboxed into one batch slice of the input tensor.
+    struct SliceGeometry {
+        ts::TSRect_T<int> roi = {0, 0, 0, 0};
+        float scale = 1.0f;
+        int xOffset = 0;
+        int yOffset = 0;
+    };
+
+    // One tile of the frame and its overlap with each neighbour, 0 on the frame border.
+    struct Tile {
+        ts::TSRect_T<int> rect;
+        int left = 0;
+        int top = 0;
+        int right = 0;
+        int bottom = 0;
+
+        // A box touching an inner side and smaller than the overlap there is cut by the
+        // seam, it is whole in the neighbour.
+        bool cuts(const ts::TSRect_T<int>& box) const;
+    };
+
+    // Holds an engine of the pool for one detection, m_task points to it.
+    class EngineLease {
+    public:
+        explicit EngineLease(TSObjectDetectionImpl& impl);
+        ~EngineLease();
+
+    private:
+        TSObjectDetectionImpl& m_impl;
+    };
+
+    // Mask slot of the decodes which must not be masked.
+    static const size_t NO_MASK = static_cast<size_t>(-1);
+
+    // Input slices and letterboxes of the engines once built.
+    bool SetupInput();
+    void* InputSlice(const int slice);
+    bool PreProcess(const ts::TSImgData& frame, const int slice);
+    // Detection of one frame into m_detections, gated by motion.
+    bool DetectFrame(const ts::TSImgData& image);
+    bool Inference(const ts::TSImgData& image, const ts::TSRect_T<int>& roi);
+    MotionDecision GateMotion(const ts::TSImgData& image, ts::TSRect_T<int>& region);
+    void LayoutTiles(const ts::TSRect_T<int>& area);
+    // Inference and decode of image regions in batches, region i uses mask slot maskBase + i.
+    bool DetectRegions(const ts::TSImgData& image, const std::vector<Tile>& regions,
+        const size_t maskBase);
+    bool DetectTiles(const ts::TSImgData& image, const ts::TSRect_T<int>& area);
+    bool Refine(const ts::TSImgData& image, const ts::TSRect_T<int>& area);
+    void LayoutMosaic(const int frameWidth, const int frameHeight);
+    bool DetectMosaic(const ts::TSImgData& image);
+    bool GetHeads(const int slice, const size_t maskSlot);
+    bool Decode(const int slice, const size_t maskSlot, const ts::YoloDecodeParams& params);
+    bool PostProcess();
 
-    // to-do: aic inference task resources
-    std::unique_ptr<snpetask::SNPETask> m_task;
+    // Engines of the model, possibly shared with other instances. m_task is the engine
+    // held during a detection, it still gives the shapes once released.
+    std::shared_ptr<ts::TSEnginePool> m_engines;
+    snpetask::SNPETask* m_task = nullptr;
+    int m_engineCount = 1;
+    // Requested input size, 0 for the size stored in the model.
+    int m_inputWidth = 0;
+    int m_inputHeight = 0;
+    encoding_t m_inputEncoding = ENCODING_FLOAT;
+    encoding_t m_outputEncoding = ENCODING_FLOAT;
     std::vector<std::string> m_outputLayers;
     std::vector<std::string> m_outputTensors;
+    // Model head of each requested output tensor.
+    std::vector<int> m_outputHeads;
+    // Requested batch of the resized input, 0 for 1.
+    int m_batchSize = 0;
+    // Batch size of the model, one letterbox and geometry per batch slice.
+    int m_batch = 1;
+    interp_t m_interp = INTERP_LINEAR;
+    std::vector<ts::TSLetterbox> m_letterboxes;
+    std::vector<SliceGeometry> m_slices;
+    ts::TSThreadPool m_preProcessPool;
+    ts::TSThreadPool m_postProcessPool;
+    const ts::YoloKernels* m_kernels = &ts::yoloKernels();
+    // Per frame decode work: one candidate buffer per head band.
+    std::vector<ts::YoloHead> m_heads;
+    std::vector<ts::YoloHead> m_bands;
+    std::vector<std::vector<ts::YoloCandidate> > m_bandCandidates;
+    std::vector<ts::YoloCandidate> m_candidates;
+    // Detections of the last frame, Detect returns a view of it.
+    ts::TSDetections m_detections;
+    // Work buffer of the batched Detect, so it leaves the detections of the stream alone.
+    ts::TSDetections m_batchDetections;
+    ts::TSNms m_nms;
+    bool m_classAware = false;
+    // Polygon regions, one cached mask per tile.
+    std::vector<ts::TSPolygon> m_includeRegions;
+    std::vector<ts::TSPolygon> m_excludeRegions;
+    std::vector<ts::TSRegionMask> m_regionMasks = std::vector<ts::TSRegionMask>(1);
+    // Head heights and widths each mask was last logged with.
+    std::vector<std::vector<int> > m_regionMaskGrids;
+    // Count mode work: one score map per head.
+    std::vector<ts::YoloScoreMap> m_scoreMaps;
+    std::vector<ts::YoloPeak> m_peaks;
 
     ts::TSRect_T<int> m_roi = {0, 0, 0, 0};
-    float* m_output;
-    uint32_t m_minBoxBorder = 16;
+    ts::TilingParams m_tilingParams;
+    // Tile layout of m_tileArea, the full frame job comes last and has no seams.
+    ts::TSRect_T<int> m_tileArea = {0, 0, 0, 0};
+    std::vector<Tile> m_tiles;
+    ts::MotionGateParams m_motionParams;
+    ts::TSMotionGate m_motionGate;
+    ts::MotionStats m_motionStats;
+    // Frames since the last detection on the whole ROI.
+    int m_motionFrames = 0;
+    // Previous detections outside the cropped region, kept in the results.
+    ts::TSDetections m_motionKept;
+    // Regions of the mosaic, the cells and letterboxes of their packing for the frame size.
+    std::vector<ts::TSRect_T<int> > m_mosaicRois;
+    std::vector<MosaicCell> m_mosaicCells;
+    std::vector<ts::TSLetterbox> m_mosaicLetterboxes;
+    int m_mosaicFrameWidth = 0;
+    int m_mosaicFrameHeight = 0;
+    // Slice 0 holds the mosaic, the letterboxes of the other owner must rewrite their padding.
+    bool m_mosaicTensor = false;
+    ts::FoveaParams m_foveaParams;
+    ts::FoveaStats m_foveaStats;
+    // First pass thresholds lowered to the candidate threshold.
+    ts::YoloDecodeParams m_candidateParams;
+    // Candidates of the first pass by priority, and the crops around them.
+    std::vector<size_t> m_foveaOrder;
+    std::vector<Tile> m_foveaCrops;
+    ts::TrackerParams m_trackerParams;
+    ts::TSTracker m_tracker;
+    ts::TrackerStats m_trackerStats;
+    int m_framesSinceKeyframe = 0;
+    // Tracked boxes of the last frame and their ids, Detect returns a view of them with the tracker on.
+    ts::TSDetections m_tracked;
+    std::vector<int> m_trackIds;
+    // Kept boxes have their longer side in [m_minSize, m_maxSize] model input pixels, 0 for no limit.
+    int m_minSize = 0;
+    int m_maxSize = 0;
     float m_nmsThresh = 0.5f;
-    float m_confThresh = 0.5f;
+    ts::YoloDecodeParams m_decodeParams;
+    size_t m_topK = 0;
+    size_t m_maxDetections = 0;
     float m_scaleWidth;
     float m_scaleHeight;
-    float m_scale;
-    int m_xOffset, m_yOffset;
 };
 
 #endif // __TS_FACE_DETECTION_IMPL_H__
@@ -30,38 +30,37 @@ static size_t calcSizeFromDims(const zdl::DlSystem::Dimension* dims, size_t rank
 
 
 static void createUserBuffer(zdl::DlSystem::UserBufferMap& userBufferMap,
-                      std::unordered_map<std::string, float*>& applicationBuffers,
+                      std::unordered_map<std::string, uint8_t*>& applicationBuffers,
                       std::vector<std::unique_ptr<zdl::DlSystem::IUserBuffer>>& snpeUserBackedBuffers,
+                      std::vector<std::unique_ptr<uint8_t[]>>& bufferStorage,
                       const zdl::DlSystem::TensorShape& bufferShape,
                       const char* name,
-                      float* buffer)
+                      zdl::DlSystem::UserBufferEncoding* encoding,
+                      size_t elementSize)
 {
     // Calculate the stride based on buffer strides, assuming tightly packed.
     // Note: Strides = Number of bytes to advance to the next element in each dimension.
     // For example, if a float tensor of dimension 2x4x3 is tightly packed in a buffer of 96 bytes, then the strides would be (48,12,4)
     // Note: Buffer stride is usually known and does not need to be calculated.
     std::vector<size_t> strides(bufferShape.rank());
-    strides[strides.size() - 1] = sizeof(float);
+    strides[strides.size() - 1] = elementSize;
     size_t stride = strides[strides.size() - 1];
     for (size_t i = bufferShape.rank() - 1; i > 0; i--)
     {
         stride *= bufferShape[i];
         strides[i-1] = stride;
     }
-    // const size_t bufferElementSize = sizeof(float);
-    size_t bufSize = calcSizeFromDims(bufferShape.getDimensions(), bufferShape.rank(), 1);
-    buffer = new float[bufSize];
-
-    // set the buffer encoding type
-    zdl::DlSystem::UserBufferEncodingFloat userBufferEncodingFloat;
-    // create user-backed storage to load input data onto it
-    applicationBuffers.emplace(name, buffer);
+    size_t bufSize = calcSizeFromDims(bufferShape.getDimensions(), bufferShape.rank(), elementSize);
+
+    // create user-backed storage to load input data onto it, owned by the task
+    bufferStorage.emplace_back(new uint8_t[bufSize]);
+    applicationBuffers[name] = bufferStorage.back().get();
     // create SNPE user buffer from the user-backed buffer
     zdl::DlSystem::IUserBufferFactory& ubFactory = zdl::SNPE::SNPEFactory::getUserBufferFactory();
     snpeUserBackedBuffers.push_back(ubFactory.createUserBuffer(applicationBuffers.at(name),
                                                                 bufSize,
                                                                 strides,
-                                                                &userBufferEncodingFloat));
+                                                                encoding));
     // add the user-backed buffer to the inputMap, which is later on fed to the network for execution
     userBufferMap.add(name, snpeUserBackedBuffers.back().get());
 }
@@ -79,8 +78,19 @@ SNPETask::~SNPETask()
 
 bool SNPETask::init(const std::string& model_path, const runtime_t runtime)
 {
+    std::shared_ptr<zdl::DlContainer::IDlContainer> container(
+        zdl::DlContainer::IDlContainer::open(model_path));
+    if (nullptr == container) {
+        TS_ERROR_LOG("Failed to open %s: %s", model_path.c_str(), zdl::DlSystem::getLastErrorString());
+        return false;
+    }
 
-    m_container = zdl::DlContainer::IDlContainer::open(model_path);
+    return init(container, runtime);
+}
+
+bool SNPETask::init(const std::shared_ptr<zdl::DlContainer::IDlContainer>& container, const runtime_t runtime)
+{
+    m_container = container;
 
     switch (runtime) {
         case CPU:
@@ -111,19 +121,30 @@ bool SNPETask::init(const std::string& model_path, const runtime_t runtime)
     zdl::DlSystem::PerformanceProfile_t profile = zdl::DlSystem::PerformanceProfile_t::BURST;
 
     zdl::SNPE::SNPEBuilder snpeBuilder(m_container.get());
+    if (!m_inputDimensions.empty()) {
+        // The network is resized at build time, the buffers below get the new shapes.
+        zdl::DlSystem::TensorShapeMap inputDimensions;
+        for (auto& it : m_inputDimensions) {
+            inputDimensions.add(it.first.c_str(),
+                zdl::DlSystem::TensorShape(it.second.data(), it.second.size()));
+        }
+        snpeBuilder.setInputDimensions(inputDimensions);
+    }
+
     m_snpe = snpeBuilder.setOutputLayers(m_outputLayers)
        .setRuntimeProcessorOrder(m_runtime)
        .setPerformanceProfile(profile)
        .setUseUserSuppliedBuffers(true)
        .build();
+    if (nullptr == m_snpe) {
+        TS_ERROR_LOG("Failed to build SNPE: %s", zdl::DlSystem::getLastErrorString());
+        return false;
+    }
 
     // get input tensor names of the network that need to be populated
     const auto& inputNamesOpt = m_snpe->getInputTensorNames();
     if (!inputNamesOpt) throw std::runtime_error("Error obtaining input tensor names");
     const zdl::DlSystem::StringList& inputNames = *inputNamesOpt;
-    m_inputTensorSize = inputNames.size();
-    m_inputBuffers = (float **)malloc(m_inputTensorSize * sizeof(float*));
-    int i = 0;
     // create SNPE user buffers for each application storage buffer
     for (const char* name : inputNames) {
         // get attributes of buffer by name
@@ -140,16 +161,38 @@ bool SNPETask::init(const std::string& model_path, const runtime_t runtime)
         }
         m_inputShapes.emplace(name, tensorShape);
 
-        createUserBuffer(m_inputUserBufferMap, m_inputTensors, m_inputUserBuffers, bufferShape, name, m_inputBuffers[i++]);
+        const encoding_t encoding = getInputEncoding(name);
+        if (ENCODING_TF8 == encoding) {
+            // Feed the quantization of the model so the runtime doesn't requantize,
+            // u8 pixels normalized to [0, 1] are used as is if the model has none.
+            unsigned char stepExactly0 = 0;
+            float stepSize = 1.0f / 255.0f;
+            auto modelEncoding = dynamic_cast<zdl::DlSystem::UserBufferEncodingTf8*>(
+                (*bufferAttributesOpt)->getEncoding());
+            if (nullptr != modelEncoding) {
+                stepExactly0 = modelEncoding->getStepExactly0();
+                stepSize = modelEncoding->getQuantizedStepSize();
+            }
+            m_inputQuantParams[name] = std::make_pair(stepSize, static_cast<int>(stepExactly0));
+
+            zdl::DlSystem::UserBufferEncodingTf8 userBufferEncodingTf8(stepExactly0, stepSize);
+            createUserBuffer(m_inputUserBufferMap, m_inputTensors, m_inputUserBuffers, m_bufferStorage,
+                bufferShape, name, &userBufferEncodingTf8, sizeof(uint8_t));
+        } else if (ENCODING_FP16 == encoding) {
+            zdl::DlSystem::UserBufferEncodingFloatN userBufferEncodingFp16(16);
+            createUserBuffer(m_inputUserBufferMap, m_inputTensors, m_inputUserBuffers, m_bufferStorage,
+                bufferShape, name, &userBufferEncodingFp16, sizeof(uint16_t));
+        } else {
+            zdl::DlSystem::UserBufferEncodingFloat userBufferEncodingFloat;
+            createUserBuffer(m_inputUserBufferMap, m_inputTensors, m_inputUserBuffers, m_bufferStorage,
+                bufferShape, name, &userBufferEncodingFloat, sizeof(float));
+        }
     }
 
     // get output tensor names of the network that need to be populated
     const auto& outputNamesOpt = m_snpe->getOutputTensorNames();
     if (!outputNamesOpt) throw std::runtime_error("Error obtaining output tensor names");
     const zdl::DlSystem::StringList& outputNames = *outputNamesOpt;
-    m_outputTensorSize = outputNames.size();
-    m_outputBuffers = (float **)malloc(m_outputTensorSize * sizeof(float*));
-    i = 0;
     // create SNPE user buffers for each application storage buffer
     for (const char* name : outputNames) {
         // get attributes of buffer by name
@@ -166,7 +209,26 @@ bool SNPETask::init(const std::string& model_path, const runtime_t runtime)
         }
         m_outputShapes.emplace(name, tensorShape);
 
-        createUserBuffer(m_outputUserBufferMap, m_outputTensors, m_outputUserBuffers, bufferShape, name, m_outputBuffers[i++]);
+        if (ENCODING_TF8 == m_outputEncoding) {
+            // Start from the quantization of the model, execute() updates it.
+            unsigned char stepExactly0 = 0;
+            float stepSize = 1.0f;
+            auto modelEncoding = dynamic_cast<zdl::DlSystem::UserBufferEncodingTf8*>(
+                (*bufferAttributesOpt)->getEncoding());
+            if (nullptr != modelEncoding) {
+                stepExactly0 = modelEncoding->getStepExactly0();
+                stepSize = modelEncoding->getQuantizedStepSize();
+            }
+
+            zdl::DlSystem::UserBufferEncodingTf8 userBufferEncodingTf8(stepExactly0, stepSize);
+            createUserBuffer(m_outputUserBufferMap, m_outputTensors, m_outputUserBuffers, m_bufferStorage,
+                bufferShape, name, &userBufferEncodingTf8, sizeof(uint8_t));
+        } else {
+            zdl::DlSystem::UserBufferEncodingFloat userBufferEncodingFloat;
+            createUserBuffer(m_outputUserBufferMap, m_outputTensors, m_outputUserBuffers, m_bufferStorage,
+                bufferShape, name, &userBufferEncodingFloat, sizeof(float));
+        }
+        m_outputUserBufferByName[name] = m_outputUserBuffers.back().get();
     }
 
     m_isInit = true;
@@ -180,24 +242,71 @@ bool SNPETask::deInit()
         m_snpe.reset(nullptr);
     }
 
-    for (int i = 1; i < m_inputTensorSize; i++) {
-        free(m_inputBuffers[i]);
+    m_inputUserBuffers.clear();
+    m_outputUserBuffers.clear();
+    m_inputUserBufferMap.clear();
+    m_outputUserBufferMap.clear();
+    m_outputUserBufferByName.clear();
+    m_inputTensors.clear();
+    m_inputQuantParams.clear();
+    m_outputTensors.clear();
+    m_bufferStorage.clear();
+    m_inputShapes.clear();
+    m_outputShapes.clear();
+
+    m_isInit = false;
+    return true;
+}
+
+bool SNPETask::setOutputLayers(std::vector<std::string>& outputLayers)
+{
+    for (size_t i = 0; i < outputLayers.size(); i ++) {
+        m_outputLayers.append(outputLayers[i].c_str());
+    }
+
+    return true;
+}
+
+bool SNPETask::setInputDimensions(const std::string& name, const std::vector<size_t>& dims)
+{
+    if (isInit()) {
+        TS_ERROR_LOG("The setInputDimensions() needs to be called before SNPETask is initialized!");
+        return false;
+    }
+
+    if (dims.empty()) {
+        m_inputDimensions.erase(name);
+    } else {
+        m_inputDimensions[name] = dims;
     }
-	free(m_inputBuffers);
+    return true;
+}
 
-    for (int i = 1; i < m_outputTensorSize; i++) {
-        free(m_outputBuffers[i]);
+bool SNPETask::setInputEncoding(const std::string& name, const encoding_t encoding)
+{
+    if (isInit()) {
+        TS_ERROR_LOG("The setInputEncoding() needs to be called before SNPETask is initialized!");
+        return false;
     }
-	free(m_outputBuffers);
 
+    m_inputEncodings[name] = encoding;
+    return true;
 }
 
-bool SNPETask::setOutputLayers(std::vector<std::string>& outputLayers)
+encoding_t SNPETask::getInputEncoding(const std::string& name) const
 {
-    for (size_t i = 0; i < outputLayers.size(); i ++) {
-        m_outputLayers.append(outputLayers[i].c_str());
+    auto it = m_inputEncodings.find(name);
+    return it == m_inputEncodings.end() ? ENCODING_FLOAT : it->second;
+}
+
+bool SNPETask::setOutputEncoding(const encoding_t encoding)
+{
+    if (isInit()) {
+        TS_ERROR_LOG("The setOutputEncoding() needs to be called before SNPETask is initialized!");
+        return false;
     }
 
+    m_outputEncoding = encoding;
     return true;
 }
 
@@ -232,8 +341,12 @@ std::vector<size_t> SNPETask::getOutputShape(const std::string& name)
 float* SNPETask::getInputTensor(const std::string& name)
 {
     if (isInit()) {
+        if (ENCODING_FLOAT != getInputEncoding(name)) {
+            TS_ERROR_LOG("Input tensor %s is not a float tensor!", name.c_str());
+            return nullptr;
+        }
         if (m_inputTensors.find(name) != m_inputTensors.end()) {
-            return m_inputTensors.at(name);
+            return reinterpret_cast<float*>(m_inputTensors.at(name));
         }
         TS_ERROR_LOG("Can't find any input tensor named %s", name.c_str());
         return nullptr;
@@ -243,11 +356,69 @@ float* SNPETask::getInputTensor(const std::string& name)
     }
 }
 
+uint8_t* SNPETask::getInputTensorTf8(const std::string& name)
+{
+    if (isInit()) {
+        if (ENCODING_TF8 != getInputEncoding(name)) {
+            TS_ERROR_LOG("Input tensor %s is not a TF8 tensor!", name.c_str());
+            return nullptr;
+        }
+        if (m_inputTensors.find(name) != m_inputTensors.end()) {
+            return m_inputTensors.at(name);
+        }
+        TS_ERROR_LOG("Can't find any input tensor named %s", name.c_str());
+        return nullptr;
+    } else {
+        TS_ERROR_LOG("The getInputTensorTf8() needs to be called after AICContext is initialized!");
+        return nullptr;
+    }
+}
+
+uint16_t* SNPETask::getInputTensorFp16(const std::string& name)
+{
+    if (isInit()) {
+        if (ENCODING_FP16 != getInputEncoding(name)) {
+            TS_ERROR_LOG("Input tensor %s is not a FP16 tensor!", name.c_str());
+            return nullptr;
+        }
+        if (m_inputTensors.find(name) != m_inputTensors.end()) {
+            return reinterpret_cast<uint16_t*>(m_inputTensors.at(name));
+        }
+        TS_ERROR_LOG("Can't find any input tensor named %s", name.c_str());
+        return nullptr;
+    } else {
+        TS_ERROR_LOG("The getInputTensorFp16() needs to be called after AICContext is initialized!");
+        return nullptr;
+    }
+}
+
+bool SNPETask::getInputQuantParams(const std::string& name, float& step, int& offset)
+{
+    if (!isInit()) {
+        TS_ERROR_LOG("The getInputQuantParams() needs to be called after AICContext is initialized!");
+        return false;
+    }
+
+    auto it = m_inputQuantParams.find(name);
+    if (it == m_inputQuantParams.end()) {
+        TS_ERROR_LOG("Can't find any TF8 input tensor named %s", name.c_str());
+        return false;
+    }
+
+    step = it->second.first;
+    offset = it->second.second;
+    return true;
+}
+
 float* SNPETask::getOutputTensor(const std::string& name)
 {
     if (isInit()) {
+        if (ENCODING_FLOAT != m_outputEncoding) {
+            TS_ERROR_LOG("Output tensor %s is not a float tensor!", name.c_str());
+            return nullptr;
+        }
         if (m_outputTensors.find(name) != m_outputTensors.end()) {
-            return m_outputTensors.at(name);
+            return reinterpret_cast<float*>(m_outputTensors.at(name));
         }
         TS_ERROR_LOG("Can't find any output tensor named %s", name.c_str());
         return nullptr;
@@ -257,6 +428,48 @@ float* SNPETask::getOutputTensor(const std::string& name)
     }
 }
 
+uint8_t* SNPETask::getOutputTensorTf8(const std::string& name)
+{
+    if (isInit()) {
+        if (ENCODING_TF8 != m_outputEncoding) {
+            TS_ERROR_LOG("Output tensor %s is not a TF8 tensor!", name.c_str());
+            return nullptr;
+        }
+        if (m_outputTensors.find(name) != m_outputTensors.end()) {
+            return m_outputTensors.at(name);
+        }
+        TS_ERROR_LOG("Can't find any output tensor named %s", name.c_str());
+        return nullptr;
+    } else {
+        TS_ERROR_LOG("The getOutputTensorTf8() needs to be called after AICContext is initialized!");
+        return nullptr;
+    }
+}
+
+bool SNPETask::getOutputQuantParams(const std::string& name, float& step, int& offset)
+{
+    if (!isInit()) {
+        TS_ERROR_LOG("The getOutputQuantParams() needs to be called after AICContext is initialized!");
+        return false;
+    }
+
+    auto it = m_outputUserBufferByName.find(name);
+    if (it == m_outputUserBufferByName.end()) {
+        TS_ERROR_LOG("Can't find any output tensor named %s", name.c_str());
+        return false;
+    }
+
+    auto encoding = dynamic_cast<zdl::DlSystem::UserBufferEncodingTf8*>(&it->second->getEncoding());
+    if (nullptr == encoding) {
+        TS_ERROR_LOG("Output tensor %s is not a TF8 tensor!", name.c_str());
+        return false;
+    }
+
+    step = encoding->getQuantizedStepSize();
+    offset = encoding->getStepExactly0();
+    return true;
+}
+
 bool SNPETask::execute()
 {
     if (!m_snpe->execute(m_inputUserBufferMap, m_outputUserBufferMap)) {
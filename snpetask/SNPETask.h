@@ -12,6 +12,9 @@
  * @LastEditTime: 2022-06-10 07:51:48
  */
 
+#ifndef __SNPE_TASK_H__
+#define __SNPE_TASK_H__
+
 #include <memory>
 #include <vector>
 #include <map>
@@ -38,14 +41,39 @@ public:
     ~SNPETask();
 
     bool init(const std::string& model_path, const runtime_t runtime);
+    // Build on an opened model, the tasks built from one container share it.
+    bool init(const std::shared_ptr<zdl::DlContainer::IDlContainer>& container, const runtime_t runtime);
     bool deInit();
     bool setOutputLayers(std::vector<std::string>& outputLayers);
 
+    // Must be called before init(), overrides the input dimensions stored in the model.
+    bool setInputDimensions(const std::string& name, const std::vector<size_t>& dims);
+
+    // Must be called before init(), inputs without an encoding are ENCODING_FLOAT.
+    bool setInputEncoding(const std::string& name, const encoding_t encoding);
+    encoding_t getInputEncoding(const std::string& name) const;
+
+    // Must be called before init(), ENCODING_FLOAT by default.
+    bool setOutputEncoding(const encoding_t encoding);
+    encoding_t getOutputEncoding() const {
+        return m_outputEncoding;
+    }
+
     std::vector<size_t> getInputShape(const std::string& name);
     std::vector<size_t> getOutputShape(const std::string& name);
 
     float* getInputTensor(const std::string& name);
+    // Input buffer of ENCODING_TF8 inputs.
+    uint8_t* getInputTensorTf8(const std::string& name);
+    // Input buffer of ENCODING_FP16 inputs, one IEEE half float per element.
+    uint16_t* getInputTensorFp16(const std::string& name);
+    // Quantization of a ENCODING_TF8 input: q = round(real / step) + offset.
+    bool getInputQuantParams(const std::string& name, float& step, int& offset);
     float* getOutputTensor(const std::string& name);
+    // Output buffer of ENCODING_TF8 outputs.
+    uint8_t* getOutputTensorTf8(const std::string& name);
+    // Quantization of a ENCODING_TF8 output: real = (q - offset) * step, updated by execute().
+    bool getOutputQuantParams(const std::string& name, float& step, int& offset);
 
     bool isInit() {
         return m_isInit;
@@ -56,7 +84,7 @@ public:
 private:
     bool m_isInit = false;
 
-    std::unique_ptr<zdl::DlContainer::IDlContainer> m_container;
+    std::shared_ptr<zdl::DlContainer::IDlContainer> m_container;
     std::unique_ptr<zdl::SNPE::SNPE> m_snpe;
     zdl::DlSystem::Runtime_t m_runtime;
     zdl::DlSystem::StringList m_outputLayers;
@@ -64,15 +92,22 @@ private:
     std::map<std::string, std::vector<size_t> > m_inputShapes;
     std::map<std::string, std::vector<size_t> > m_outputShapes;
 
+    std::map<std::string, std::vector<size_t> > m_inputDimensions;
+    std::map<std::string, encoding_t> m_inputEncodings;
+    encoding_t m_outputEncoding = ENCODING_FLOAT;
+
     std::vector<std::unique_ptr<zdl::DlSystem::IUserBuffer> > m_inputUserBuffers;
     std::vector<std::unique_ptr<zdl::DlSystem::IUserBuffer> > m_outputUserBuffers;
     zdl::DlSystem::UserBufferMap m_inputUserBufferMap;
     zdl::DlSystem::UserBufferMap m_outputUserBufferMap;
-    int m_inputTensorSize, m_outputTensorSize;
-    float** m_inputBuffers;
-    float** m_outputBuffers;
-    std::unordered_map<std::string, float*> m_inputTensors;
-    std::unordered_map<std::string, float*> m_outputTensors;
+    // Application side memory of all the user buffers.
+    std::vector<std::unique_ptr<uint8_t[]> > m_bufferStorage;
+    std::unordered_map<std::string, uint8_t*> m_inputTensors;
+    std::unordered_map<std::string, std::pair<float, int> > m_inputQuantParams;
+    std::unordered_map<std::string, uint8_t*> m_outputTensors;
+    std::unordered_map<std::string, zdl::DlSystem::IUserBuffer*> m_outputUserBufferByName;
 };
 
-}   // namespace snpetask
\ No newline at end of file
+}   // namespace snpetask
+
+#endif // __SNPE_TASK_H__
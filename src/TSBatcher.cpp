@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2012-2022
+ * All Rights Reserved by Thundercomm Technology Co., Ltd. and its affiliates.
+ * You may not use, copy, distribute, modify, transmit in any form this file
+ * except in compliance with THUNDERCOMM in writing by applicable law.
+ *
+ * @Description: Implementation of the dynamic batcher.
+ * @version: 1.0
+ * @Author: Ricardo Lu<sheng.lu@thundercomm.com>
+ * @Date: 2026-10-17 19:12:46
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-17 19:12:46
+ */
+
+#include <algorithm>
+
+#include "TSBatcher.h"
+
+namespace ts {
+
+// Buckets of the wait histogram, the last one holds the waits of 2^22 us (4 s) and more.
+static const int WAIT_BUCKETS = 24;
+
+static int waitBucket(const long long us)
+{
+    int bucket = 0;
+    for (long long bound = 1; bucket < WAIT_BUCKETS - 1 && us >= bound; bound <<= 1) {
+        bucket++;
+    }
+    return bucket;
+}
+
+TSBatcher::TSBatcher(TSObjectDetection& detector, const BatcherParams& params)
+    : m_detector(detector), m_params(params)
+{
+    if (m_params.maxBatch < 1) {
+        TS_ERROR_LOG("Invalid batch size %d, frames are not batched.", m_params.maxBatch);
+        m_params.maxBatch = 1;
+    }
+    m_params.maxWaitUs = std::max(0, m_params.maxWaitUs);
+
+    m_images.reserve(m_params.maxBatch);
+    m_stats.batchSizes.assign(m_params.maxBatch + 1, 0);
+    m_stats.waits.assign(WAIT_BUCKETS, 0);
+}
+
+bool TSBatcher::Detect(const TSImgData& image, std::vector<ObjectData>& results)
+{
+    Request request;
+    request.image = &image;
+    request.results = &results;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    request.arrival = Clock::now();
+    m_queue.push_back(&request);
+    if (static_cast<int>(m_queue.size()) >= m_params.maxBatch) {
+        // Wake the leader waiting for a full batch.
+        m_cond.notify_all();
+    }
+
+    while (!request.done) {
+        if (m_leader) {
+            // The next batch is taken once the running one is done.
+            m_cond.wait(lock);
+            continue;
+        }
+
+        // Lead the next batch, its deadline follows the oldest frame waiting.
+        m_leader = true;
+        while (static_cast<int>(m_queue.size()) < m_params.maxBatch) {
+            const Clock::time_point deadline =
+                m_queue.front()->arrival + std::chrono::microseconds(m_params.maxWaitUs);
+            if (std::cv_status::timeout == m_cond.wait_until(lock, deadline)) {
+                break;
+            }
+        }
+
+        const size_t count = std::min(m_queue.size(), static_cast<size_t>(m_params.maxBatch));
+        m_batch.assign(m_queue.begin(), m_queue.begin() + count);
+        m_queue.erase(m_queue.begin(), m_queue.begin() + count);
+        const Clock::time_point start = Clock::now();
+        lock.unlock();
+
+        // Views of the pixels of the callers, still blocked until done. They are built
+        // in place in the reserved vector, a TSImgData copy would copy the pixels.
+        m_images.clear();
+        for (const auto* waiting : m_batch) {
+            const TSImgData& image = *waiting->image;
+            uint8_t* const planes[3] = {image.plane(0), image.plane(1), image.plane(2)};
+            const int32_t strides[3] = {image.planeStride(0), image.planeStride(1), image.planeStride(2)};
+            m_images.emplace_back(image.width(), image.height(), image.format(), planes, strides);
+        }
+        const bool ok = m_detector.Detect(m_images, m_results);
+
+        lock.lock();
+        for (size_t i = 0; i < count; i++) {
+            Request* waiting = m_batch[i];
+            if (ok) {
+                waiting->results->insert(waiting->results->end(),
+                    m_results[i].begin(), m_results[i].end());
+            }
+            waiting->ok = ok;
+            waiting->done = true;
+            m_stats.waits[waitBucket(std::chrono::duration_cast<std::chrono::microseconds>(
+                start - waiting->arrival).count())]++;
+        }
+        m_stats.frames += count;
+        m_stats.batches++;
+        m_stats.batchSizes[count]++;
+        m_leader = false;
+        m_cond.notify_all();
+    }
+
+    return request.ok;
+}
+
+bool TSBatcher::GetStats(BatcherStats& stats)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    stats = m_stats;
+    return true;
+}
+
+} // namespace ts
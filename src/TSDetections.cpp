@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2012-2022
+ * All Rights Reserved by Thundercomm Technology Co., Ltd. and its affiliates.
+ * You may not use, copy, distribute, modify, transmit in any form this file
+ * except in compliance with THUNDERCOMM in writing by applicable law.
+ *
+ * @Description: Implementation of struct-of-arrays detection buffer.
+ * @version: 1.0
+ * @Author: Ricardo Lu<sheng.lu@thundercomm.com>
+ * @Date: 2026-10-17 19:20:44
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-17 19:20:44
+ */
+
+#include <string.h>
+#include <utility>
+
+#include "TSDetections.h"
+
+namespace ts {
+
+static const int DETECTION_FIELDS = 6;
+
+void TSDetections::reserve(const size_t capacity)
+{
+    if (capacity <= m_capacity) {
+        return;
+    }
+
+    static_assert(sizeof(int) == 4 && sizeof(float) == 4, "4 bytes fields expected");
+    std::unique_ptr<unsigned char[]> arena(new unsigned char[capacity * DETECTION_FIELDS * 4]);
+
+    int* x = reinterpret_cast<int*>(arena.get());
+    int* y = x + capacity;
+    int* width = y + capacity;
+    int* height = width + capacity;
+    float* confidence = reinterpret_cast<float*>(height + capacity);
+    int* label = reinterpret_cast<int*>(confidence + capacity);
+
+    if (m_size) {
+        memcpy(x, m_x, m_size * sizeof(int));
+        memcpy(y, m_y, m_size * sizeof(int));
+        memcpy(width, m_width, m_size * sizeof(int));
+        memcpy(height, m_height, m_size * sizeof(int));
+        memcpy(confidence, m_confidence, m_size * sizeof(float));
+        memcpy(label, m_label, m_size * sizeof(int));
+    }
+
+    m_arena = std::move(arena);
+    m_capacity = capacity;
+    m_x = x;
+    m_y = y;
+    m_width = width;
+    m_height = height;
+    m_confidence = confidence;
+    m_label = label;
+}
+
+DetectionView TSDetections::view() const
+{
+    DetectionView v;
+    v.size = m_size;
+    v.x = m_x;
+    v.y = m_y;
+    v.width = m_width;
+    v.height = m_height;
+    v.confidence = m_confidence;
+    v.label = m_label;
+    return v;
+}
+
+void TSDetections::swap(TSDetections& other)
+{
+    std::swap(m_arena, other.m_arena);
+    std::swap(m_size, other.m_size);
+    std::swap(m_capacity, other.m_capacity);
+    std::swap(m_x, other.m_x);
+    std::swap(m_y, other.m_y);
+    std::swap(m_width, other.m_width);
+    std::swap(m_height, other.m_height);
+    std::swap(m_confidence, other.m_confidence);
+    std::swap(m_label, other.m_label);
+}
+
+} // namespace ts
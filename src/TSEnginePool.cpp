@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2012-2022
+ * All Rights Reserved by Thundercomm Technology Co., Ltd. and its affiliates.
+ * You may not use, copy, distribute, modify, transmit in any form this file
+ * except in compliance with THUNDERCOMM in writing by applicable law.
+ *
+ * @Description: Implementation of the SNPE engine pool.
+ * @version: 1.0
+ * @Author: Ricardo Lu<sheng.lu@thundercomm.com>
+ * @Date: 2026-10-17 20:41:09
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-17 20:41:09
+ */
+
+#include <chrono>
+
+#include "TSEnginePool.h"
+
+namespace ts {
+
+// Buckets of the wait histogram, the last one holds the waits of 2^22 us (4 s) and more.
+static const int WAIT_BUCKETS = 24;
+
+static int waitBucket(const long long us)
+{
+    int bucket = 0;
+    for (long long bound = 1; bucket < WAIT_BUCKETS - 1 && us >= bound; bound <<= 1) {
+        bucket++;
+    }
+    return bucket;
+}
+
+TSEnginePool::~TSEnginePool()
+{
+    clear();
+}
+
+void TSEnginePool::clear()
+{
+    // The engines after a failed one were never created.
+    for (auto& engine : m_engines) {
+        if (engine.task) {
+            engine.task->deInit();
+        }
+    }
+    m_engines.clear();
+}
+
+bool TSEnginePool::init(const std::string& model_path, const runtime_t runtime, const int count,
+    const std::function<bool(snpetask::SNPETask&)>& setup)
+{
+    if (count < 1) {
+        TS_ERROR_LOG("Invalid engine number %d!", count);
+        return false;
+    }
+
+    std::shared_ptr<zdl::DlContainer::IDlContainer> container(
+        zdl::DlContainer::IDlContainer::open(model_path));
+    if (nullptr == container) {
+        TS_ERROR_LOG("Failed to open %s", model_path.c_str());
+        return false;
+    }
+
+    m_engines.resize(count);
+    for (int i = 0; i < count; i++) {
+        m_engines[i].task.reset(new snpetask::SNPETask());
+        if (!setup(*m_engines[i].task) || !m_engines[i].task->init(container, runtime)) {
+            TS_ERROR_LOG("Failed to build engine %d of %s", i, model_path.c_str());
+            clear();
+            return false;
+        }
+    }
+
+    m_stats.engines = count;
+    m_stats.waits.assign(WAIT_BUCKETS, 0);
+    return true;
+}
+
+snpetask::SNPETask* TSEnginePool::acquire(const void* user, bool& reused)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    const size_t ticket = m_nextTicket++;
+
+    // Only time the callers which can't be served at once.
+    auto idle = [this] () {
+        for (const auto& engine : m_engines) {
+            if (!engine.busy) {
+                return true;
+            }
+        }
+        return false;
+    };
+    long long waited = 0;
+    if (ticket != m_serving || !idle()) {
+        const auto start = std::chrono::steady_clock::now();
+        m_cond.wait(lock, [&] () {
+            return ticket == m_serving && idle();
+        });
+        waited = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        m_stats.waited++;
+    }
+    m_serving++;
+    m_stats.acquires++;
+    m_stats.waits[waitBucket(waited)]++;
+
+    // The engine last used by the caller keeps its letterbox padding.
+    Engine* chosen = nullptr;
+    for (auto& engine : m_engines) {
+        if (!engine.busy && (nullptr == chosen || engine.lastUser == user)) {
+            chosen = &engine;
+            if (engine.lastUser == user) {
+                break;
+            }
+        }
+    }
+    reused = chosen->lastUser == user;
+    chosen->busy = true;
+    chosen->lastUser = user;
+
+    // The next caller in line may find another idle engine.
+    m_cond.notify_all();
+    return chosen->task.get();
+}
+
+void TSEnginePool::release(snpetask::SNPETask* task)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& engine : m_engines) {
+        if (engine.task.get() == task) {
+            engine.busy = false;
+            break;
+        }
+    }
+    m_cond.notify_all();
+}
+
+void TSEnginePool::stats(ts::EngineStats& stats)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    stats = m_stats;
+}
+
+} // namespace ts
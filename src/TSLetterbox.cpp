@@ -0,0 +1,529 @@
+/*
+ * Copyright (c) 2012-2022
+ * All Rights Reserved by Thundercomm Technology Co., Ltd. and its affiliates.
+ * You may not use, copy, distribute, modify, transmit in any form this file
+ * except in compliance with THUNDERCOMM in writing by applicable law.
+ *
+ * @Description: Implementation of fused letterbox kernel.
+ * @version: 1.1
+ * @Author: Ricardo Lu<sheng.lu@thundercomm.com>
+ * @Date: 2026-10-17 10:21:37
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-17 10:21:37
+ */
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#include "TSLetterbox.h"
+
+namespace ts {
+
+// Same precision as the fixed-point resize coefficients of OpenCV.
+static const int RESIZE_COEF_BITS = 11;
+static const int RESIZE_COEF_SCALE = 1 << RESIZE_COEF_BITS;
+static const float LINEAR_NORM = 1.0f / (255.0f * RESIZE_COEF_SCALE * RESIZE_COEF_SCALE);
+static const float PAD_VALUE = 128 / 255.0f;
+static const float INV_255 = 1.0f / 255.0f;
+
+// u8 to normalized float, bit-identical to convertTo(CV_32F) then /= 255.0f.
+struct NormTable {
+    float value[256];
+    NormTable() {
+        for (int i = 0; i < 256; i++) {
+            value[i] = i / 255.0f;
+        }
+    }
+};
+
+static const float* floatNormTable()
+{
+    static const NormTable table;
+    return table.value;
+}
+
+// Round to nearest even float to IEEE half conversion.
+static inline uint16_t floatToHalf(float value)
+{
+    uint32_t f;
+    memcpy(&f, &value, sizeof(f));
+    const uint32_t sign = (f >> 16) & 0x8000;
+    f &= 0x7fffffff;
+
+    if (f >= 0x47800000) {
+        // Overflow to infinity, NaN stays a quiet NaN.
+        return sign | (f > 0x7f800000 ? 0x7e00 : 0x7c00);
+    }
+
+    if (f < 0x38800000) {
+        // Subnormal or zero: adding 0.5 aligns the half precision LSB to the float one,
+        // the float addition does the rounding.
+        float v;
+        memcpy(&v, &f, sizeof(v));
+        v += 0.5f;
+        memcpy(&f, &v, sizeof(f));
+        return sign | (f - 0x3f000000);
+    }
+
+    // Rebias the exponent from 127 to 15 and round the 13 dropped mantissa bits to even.
+    f += 0xc8000fff + ((f >> 13) & 1);
+    return sign | (f >> 13);
+}
+
+bool TSLetterbox::setEncoding(const encoding_t encoding, const float step, const int offset)
+{
+    if (ENCODING_FLOAT != encoding && ENCODING_TF8 != encoding && ENCODING_FP16 != encoding) {
+        TS_ERROR_LOG("Unsupported tensor encoding %d!", encoding);
+        return false;
+    }
+
+    if (ENCODING_TF8 == encoding && (step <= 0.0f || offset < 0 || offset > 255)) {
+        TS_ERROR_LOG("Invalid TF8 quantization step %f offset %d!", step, offset);
+        return false;
+    }
+
+    m_encoding = encoding;
+    m_quantScale = 1.0f / step;
+    m_quantOffset = offset;
+
+    const float* norm = floatNormTable();
+    for (int i = 0; i < 256; i++) {
+        store(m_normTf8 + i, norm[i]);
+        m_normFp16[i] = floatToHalf(norm[i]);
+    }
+
+    // The padding has to be rewritten in the new encoding.
+    m_valid = false;
+    return true;
+}
+
+void TSLetterbox::store(float* dst, float v) const
+{
+    *dst = v;
+}
+
+void TSLetterbox::store(uint8_t* dst, float v) const
+{
+    const int q = static_cast<int>(lrintf(v * m_quantScale)) + m_quantOffset;
+    *dst = static_cast<uint8_t>(q < 0 ? 0 : (q > 255 ? 255 : q));
+}
+
+void TSLetterbox::store(uint16_t* dst, float v) const
+{
+    *dst = floatToHalf(v);
+}
+
+const float* TSLetterbox::normTable(const float*) const
+{
+    return floatNormTable();
+}
+
+static inline float clamp01(float v)
+{
+    return v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+}
+
+// BT.601 limited range, the same conversion as cv::COLOR_YUV2RGB_NV12.
+static inline void yuv2rgb(float y, int u, int v, float* rgb)
+{
+    const float c = (y - 16.0f) * 1.164f;
+    const float d = u - 128.0f;
+    const float e = v - 128.0f;
+    rgb[0] = clamp01((c + 1.596f * e) * INV_255);
+    rgb[1] = clamp01((c - 0.391f * d - 0.813f * e) * INV_255);
+    rgb[2] = clamp01((c + 2.018f * d) * INV_255);
+}
+
+// Chroma is sampled once per output pixel at the source position of the pixel centre.
+static void chromaCoefs(int dstSize, int srcSize, std::vector<int>& idx, int step)
+{
+    double inv = static_cast<double>(srcSize) / dstSize;
+    idx.resize(dstSize);
+    for (int d = 0; d < dstSize; d++) {
+        int s = std::min(static_cast<int>((d + 0.5) * inv), srcSize - 1);
+        idx[d] = (s >> 1) * step;
+    }
+}
+
+static void linearCoefs(int dstSize, int srcSize, std::vector<int>& idx0,
+    std::vector<int>& idx1, std::vector<int>& weight, int step)
+{
+    double inv = static_cast<double>(srcSize) / dstSize;
+    idx0.resize(dstSize);
+    idx1.resize(dstSize);
+    weight.resize(dstSize);
+    for (int d = 0; d < dstSize; d++) {
+        double f = (d + 0.5) * inv - 0.5;
+        int s = static_cast<int>(floor(f));
+        f -= s;
+        if (s < 0) {
+            s = 0;
+            f = 0;
+        }
+        if (s >= srcSize - 1) {
+            s = srcSize - 1;
+            f = 0;
+        }
+        idx0[d] = s * step;
+        idx1[d] = std::min(s + 1, srcSize - 1) * step;
+        weight[d] = static_cast<int>(lrint(f * RESIZE_COEF_SCALE));
+    }
+}
+
+static void nearestCoefs(int dstSize, int srcSize, std::vector<int>& idx0, int step)
+{
+    double inv = static_cast<double>(srcSize) / dstSize;
+    idx0.resize(dstSize);
+    for (int d = 0; d < dstSize; d++) {
+        idx0[d] = std::min(static_cast<int>(floor(d * inv)), srcSize - 1) * step;
+    }
+}
+
+static void areaCoefs(int dstSize, int srcSize, std::vector<int>& idx0,
+    std::vector<int>& idx1, int step)
+{
+    double inv = static_cast<double>(srcSize) / dstSize;
+    idx0.resize(dstSize);
+    idx1.resize(dstSize);
+    for (int d = 0; d < dstSize; d++) {
+        int s0 = std::min(static_cast<int>(floor(d * inv)), srcSize - 1);
+        int s1 = std::min(static_cast<int>(floor((d + 1) * inv)), srcSize);
+        idx0[d] = s0 * step;
+        idx1[d] = std::max(s1, s0 + 1) * step;
+    }
+}
+
+void TSLetterbox::buildTables(int srcWidth, int srcHeight)
+{
+    interp_t interp = m_interp;
+    // Area averaging only makes sense for shrinking, enlarging falls back to linear like OpenCV.
+    if (interp == INTERP_AREA && (m_scaledWidth > srcWidth || m_scaledHeight > srcHeight)) {
+        interp = INTERP_LINEAR;
+    }
+
+    m_xIdx0.clear(); m_xIdx1.clear(); m_xWeight.clear();
+    m_yIdx0.clear(); m_yIdx1.clear(); m_yWeight.clear();
+
+    switch (interp) {
+        case INTERP_NEAREST:
+            nearestCoefs(m_scaledWidth, srcWidth, m_xIdx0, m_pixelStep);
+            nearestCoefs(m_scaledHeight, srcHeight, m_yIdx0, 1);
+            break;
+        case INTERP_AREA:
+            areaCoefs(m_scaledWidth, srcWidth, m_xIdx0, m_xIdx1, m_pixelStep);
+            areaCoefs(m_scaledHeight, srcHeight, m_yIdx0, m_yIdx1, 1);
+            break;
+        case INTERP_LINEAR:
+        default:
+            linearCoefs(m_scaledWidth, srcWidth, m_xIdx0, m_xIdx1, m_xWeight, m_pixelStep);
+            linearCoefs(m_scaledHeight, srcHeight, m_yIdx0, m_yIdx1, m_yWeight, 1);
+            break;
+    }
+}
+
+template <typename T>
+void TSLetterbox::fillRow(const Source& in, T* dst, int dy) const
+{
+    if (m_yuv) {
+        fillRowYuv(in, dst, dy);
+        return;
+    }
+
+    const T* norm = normTable(dst);
+    const uint8_t* src = in.data;
+    const int srcStride = in.stride;
+    const int step = m_pixelStep;
+    const int ci0 = m_channelIdx[0], ci1 = m_channelIdx[1], ci2 = m_channelIdx[2];
+
+    // Same size: plain channel swap and normalization, no resize at all.
+    if (m_xIdx0.empty()) {
+        const uint8_t* s = src + dy * srcStride;
+        for (int dx = 0; dx < m_scaledWidth; dx++, s += step, dst += 3) {
+            dst[0] = norm[s[ci0]];
+            dst[1] = norm[s[ci1]];
+            dst[2] = norm[s[ci2]];
+        }
+        return;
+    }
+
+    if (!m_xWeight.empty()) {
+        const uint8_t* r0 = src + m_yIdx0[dy] * srcStride;
+        const uint8_t* r1 = src + m_yIdx1[dy] * srcStride;
+        const int wy1 = m_yWeight[dy];
+        const int wy0 = RESIZE_COEF_SCALE - wy1;
+        for (int dx = 0; dx < m_scaledWidth; dx++, dst += 3) {
+            const uint8_t* p00 = r0 + m_xIdx0[dx];
+            const uint8_t* p01 = r0 + m_xIdx1[dx];
+            const uint8_t* p10 = r1 + m_xIdx0[dx];
+            const uint8_t* p11 = r1 + m_xIdx1[dx];
+            const int wx1 = m_xWeight[dx];
+            const int wx0 = RESIZE_COEF_SCALE - wx1;
+            int c0 = (p00[ci0] * wx0 + p01[ci0] * wx1) * wy0 + (p10[ci0] * wx0 + p11[ci0] * wx1) * wy1;
+            int c1 = (p00[ci1] * wx0 + p01[ci1] * wx1) * wy0 + (p10[ci1] * wx0 + p11[ci1] * wx1) * wy1;
+            int c2 = (p00[ci2] * wx0 + p01[ci2] * wx1) * wy0 + (p10[ci2] * wx0 + p11[ci2] * wx1) * wy1;
+            store(dst, c0 * LINEAR_NORM);
+            store(dst + 1, c1 * LINEAR_NORM);
+            store(dst + 2, c2 * LINEAR_NORM);
+        }
+    } else if (!m_xIdx1.empty()) {
+        const int y0 = m_yIdx0[dy], y1 = m_yIdx1[dy];
+        for (int dx = 0; dx < m_scaledWidth; dx++, dst += 3) {
+            const int x0 = m_xIdx0[dx], x1 = m_xIdx1[dx];
+            int c0 = 0, c1 = 0, c2 = 0;
+            for (int y = y0; y < y1; y++) {
+                const uint8_t* row = src + y * srcStride;
+                for (int x = x0; x < x1; x += step) {
+                    c0 += row[x + ci0];
+                    c1 += row[x + ci1];
+                    c2 += row[x + ci2];
+                }
+            }
+            const float inv = 1.0f / (255.0f * (y1 - y0) * ((x1 - x0) / step));
+            store(dst, c0 * inv);
+            store(dst + 1, c1 * inv);
+            store(dst + 2, c2 * inv);
+        }
+    } else {
+        const uint8_t* row = src + m_yIdx0[dy] * srcStride;
+        for (int dx = 0; dx < m_scaledWidth; dx++, dst += 3) {
+            const uint8_t* s = row + m_xIdx0[dx];
+            dst[0] = norm[s[ci0]];
+            dst[1] = norm[s[ci1]];
+            dst[2] = norm[s[ci2]];
+        }
+    }
+}
+
+template <typename T>
+void TSLetterbox::fillRowYuv(const Source& in, T* dst, int dy) const
+{
+    const uint8_t* src = in.data;
+    const int srcStride = in.stride;
+    const uint8_t* u = in.u + m_yUv[dy] * in.uvStride;
+    const uint8_t* v = in.v + m_yUv[dy] * in.uvStride;
+    const int* cx = m_xUv.data();
+    float rgb[3];
+
+    // Only the luma is resized, the subsampled chroma is picked at the pixel centre.
+    if (m_xIdx0.empty()) {
+        const uint8_t* row = src + dy * srcStride;
+        for (int dx = 0; dx < m_scaledWidth; dx++, dst += 3) {
+            yuv2rgb(row[dx], u[cx[dx]], v[cx[dx]], rgb);
+            store(dst, rgb[0]);
+            store(dst + 1, rgb[1]);
+            store(dst + 2, rgb[2]);
+        }
+    } else if (!m_xWeight.empty()) {
+        static const float norm = 1.0f / (RESIZE_COEF_SCALE * RESIZE_COEF_SCALE);
+        const uint8_t* r0 = src + m_yIdx0[dy] * srcStride;
+        const uint8_t* r1 = src + m_yIdx1[dy] * srcStride;
+        const int wy1 = m_yWeight[dy];
+        const int wy0 = RESIZE_COEF_SCALE - wy1;
+        for (int dx = 0; dx < m_scaledWidth; dx++, dst += 3) {
+            const int x0 = m_xIdx0[dx], x1 = m_xIdx1[dx];
+            const int wx1 = m_xWeight[dx];
+            const int wx0 = RESIZE_COEF_SCALE - wx1;
+            int luma = (r0[x0] * wx0 + r0[x1] * wx1) * wy0 + (r1[x0] * wx0 + r1[x1] * wx1) * wy1;
+            yuv2rgb(luma * norm, u[cx[dx]], v[cx[dx]], rgb);
+            store(dst, rgb[0]);
+            store(dst + 1, rgb[1]);
+            store(dst + 2, rgb[2]);
+        }
+    } else if (!m_xIdx1.empty()) {
+        const int y0 = m_yIdx0[dy], y1 = m_yIdx1[dy];
+        for (int dx = 0; dx < m_scaledWidth; dx++, dst += 3) {
+            const int x0 = m_xIdx0[dx], x1 = m_xIdx1[dx];
+            int luma = 0;
+            for (int y = y0; y < y1; y++) {
+                const uint8_t* row = src + y * srcStride;
+                for (int x = x0; x < x1; x++) {
+                    luma += row[x];
+                }
+            }
+            yuv2rgb(luma / static_cast<float>((y1 - y0) * (x1 - x0)), u[cx[dx]], v[cx[dx]], rgb);
+            store(dst, rgb[0]);
+            store(dst + 1, rgb[1]);
+            store(dst + 2, rgb[2]);
+        }
+    } else {
+        const uint8_t* row = src + m_yIdx0[dy] * srcStride;
+        for (int dx = 0; dx < m_scaledWidth; dx++, dst += 3) {
+            yuv2rgb(row[m_xIdx0[dx]], u[cx[dx]], v[cx[dx]], rgb);
+            store(dst, rgb[0]);
+            store(dst + 1, rgb[1]);
+            store(dst + 2, rgb[2]);
+        }
+    }
+}
+
+bool TSLetterbox::configure(int srcWidth, int srcHeight, int srcFormat,
+    void* tensor, int tensorWidth, int tensorHeight)
+{
+    if (m_valid && srcWidth == m_srcWidth && srcHeight == m_srcHeight && srcFormat == m_srcFormat &&
+        tensor == m_tensor && tensorWidth == m_tensorWidth && tensorHeight == m_tensorHeight &&
+        m_interp == m_tableInterp && m_window == m_tableWindow && m_area == m_tableArea) {
+        return false;
+    }
+
+    m_srcFormat = srcFormat;
+    m_yuv = TYPE_NV12 == srcFormat || TYPE_I420 == srcFormat;
+    m_pixelStep = m_yuv ? 1 : ((TYPE_BGRX_U8 == srcFormat || TYPE_RGBX_U8 == srcFormat) ? 4 : 3);
+    m_channelIdx[0] = (TYPE_BGR_U8 == srcFormat || TYPE_BGRX_U8 == srcFormat) ? 2 : 0;
+    m_channelIdx[1] = 1;
+    m_channelIdx[2] = (TYPE_BGR_U8 == srcFormat || TYPE_BGRX_U8 == srcFormat) ? 0 : 2;
+
+    m_srcWidth = srcWidth;
+    m_srcHeight = srcHeight;
+    m_tensor = tensor;
+    m_tensorWidth = tensorWidth;
+    m_tensorHeight = tensorHeight;
+    m_tableInterp = m_interp;
+    m_tableWindow = m_window;
+    m_tableArea = m_area;
+
+    const TSRect_T<int> window = m_window.empty() ? TSRect_T<int>(0, 0, tensorWidth, tensorHeight) : m_window;
+    m_scale = std::min(window.height / (float)srcHeight, window.width / (float)srcWidth);
+    m_scaledWidth = std::max(1, static_cast<int>(srcWidth * m_scale));
+    m_scaledHeight = std::max(1, static_cast<int>(srcHeight * m_scale));
+    m_xOffset = window.x + (window.width - m_scaledWidth) / 2;
+    m_yOffset = window.y + (window.height - m_scaledHeight) / 2;
+
+    if (m_scaledWidth == srcWidth && m_scaledHeight == srcHeight) {
+        m_xIdx0.clear(); m_xIdx1.clear(); m_xWeight.clear();
+        m_yIdx0.clear(); m_yIdx1.clear(); m_yWeight.clear();
+    } else {
+        buildTables(srcWidth, srcHeight);
+    }
+
+    if (m_yuv) {
+        chromaCoefs(m_scaledWidth, srcWidth, m_xUv, TYPE_NV12 == srcFormat ? 2 : 1);
+        chromaCoefs(m_scaledHeight, srcHeight, m_yUv, 1);
+    }
+
+    m_valid = true;
+    return true;
+}
+
+template <typename T>
+void TSLetterbox::fillPadding(T* tensor) const
+{
+    T pad;
+    store(&pad, PAD_VALUE);
+
+    const TSRect_T<int> window = !m_tableArea.empty() ? m_tableArea : (m_tableWindow.empty() ?
+        TSRect_T<int>(0, 0, m_tensorWidth, m_tensorHeight) : m_tableWindow);
+    const int rowLen = m_tensorWidth * 3;
+    for (int dy = window.y; dy < window.y + window.height; dy++) {
+        T* row = tensor + dy * rowLen;
+        if (dy < m_yOffset || dy >= m_yOffset + m_scaledHeight) {
+            std::fill(row + window.x * 3, row + (window.x + window.width) * 3, pad);
+        } else {
+            std::fill(row + window.x * 3, row + m_xOffset * 3, pad);
+            std::fill(row + (m_xOffset + m_scaledWidth) * 3, row + (window.x + window.width) * 3, pad);
+        }
+    }
+}
+
+template <typename T>
+void TSLetterbox::fill(const Source& in, T* tensor, bool padding, TSThreadPool* pool) const
+{
+    // The gray bars never change for a given geometry, write them once and
+    // only refresh the letterboxed region on the following frames.
+    if (padding) {
+        fillPadding(tensor);
+    }
+
+    const int rowLen = m_tensorWidth * 3;
+    if (nullptr == pool || pool->size() == 1) {
+        for (int dy = 0; dy < m_scaledHeight; dy++) {
+            fillRow(in, tensor + (m_yOffset + dy) * rowLen + m_xOffset * 3, dy);
+        }
+        return;
+    }
+
+    // Every row only depends on the source and the tables, so splitting the
+    // letterboxed region into horizontal bands gives the exact same tensor.
+    const int bands = std::min(pool->size(), m_scaledHeight);
+    pool->parallelFor(bands, [&](int band) {
+        int begin = m_scaledHeight * band / bands;
+        int end = m_scaledHeight * (band + 1) / bands;
+        for (int dy = begin; dy < end; dy++) {
+            fillRow(in, tensor + (m_yOffset + dy) * rowLen + m_xOffset * 3, dy);
+        }
+    });
+}
+
+bool TSLetterbox::run(const ts::TSImgData& image, void* tensor, int tensorWidth, int tensorHeight,
+    TSThreadPool* pool)
+{
+    if (nullptr == tensor || tensorWidth <= 0 || tensorHeight <= 0) {
+        TS_ERROR_LOG("Invalid input tensor!");
+        return false;
+    }
+
+    if (image.empty()) {
+        TS_ERROR_LOG("Invalid image!");
+        return false;
+    }
+
+    if (!m_window.empty() && (m_window.x < 0 || m_window.y < 0 ||
+        m_window.x + m_window.width > tensorWidth || m_window.y + m_window.height > tensorHeight)) {
+        TS_ERROR_LOG("Letterbox window out of the tensor!");
+        return false;
+    }
+
+    if (!m_area.empty() && (m_window.empty() || m_area.x < 0 || m_area.y < 0 ||
+        m_area.x + m_area.width > tensorWidth || m_area.y + m_area.height > tensorHeight ||
+        m_window.x < m_area.x || m_window.y < m_area.y || m_window.x + m_window.width > m_area.x + m_area.width ||
+        m_window.y + m_window.height > m_area.y + m_area.height)) {
+        TS_ERROR_LOG("Letterbox padded area out of the tensor or not around the window!");
+        return false;
+    }
+
+    int imgFormat = image.format();
+    if (imgFormat != TYPE_BGR_U8 && imgFormat != TYPE_RGB_U8 &&
+        imgFormat != TYPE_BGRX_U8 && imgFormat != TYPE_RGBX_U8 &&
+        imgFormat != TYPE_NV12 && imgFormat != TYPE_I420) {
+        TS_ERROR_LOG("Invaild image format %d, expected to be rgb, bgr, rgbx, bgrx, nv12 or i420!", imgFormat);
+        return false;
+    }
+
+    Source in;
+    in.data = image.data();
+    in.stride = image.stride();
+    if (TYPE_NV12 == imgFormat) {
+        in.u = image.plane(1);
+        in.v = image.plane(1) + 1;
+        in.uvStride = image.planeStride(1);
+    } else if (TYPE_I420 == imgFormat) {
+        in.u = image.plane(1);
+        in.v = image.plane(2);
+        in.uvStride = image.planeStride(1);
+    }
+
+    if ((TYPE_NV12 == imgFormat || TYPE_I420 == imgFormat) && (nullptr == in.u || nullptr == in.v)) {
+        TS_ERROR_LOG("Missing chroma planes!");
+        return false;
+    }
+
+    const bool padding = configure(image.width(), image.height(), imgFormat,
+        tensor, tensorWidth, tensorHeight);
+
+    switch (m_encoding) {
+        case ENCODING_TF8:
+            fill(in, static_cast<uint8_t*>(tensor), padding, pool);
+            break;
+        case ENCODING_FP16:
+            fill(in, static_cast<uint16_t*>(tensor), padding, pool);
+            break;
+        case ENCODING_FLOAT:
+        default:
+            fill(in, static_cast<float*>(tensor), padding, pool);
+            break;
+    }
+
+    return true;
+}
+
+} // namespace ts
@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2012-2022
+ * All Rights Reserved by Thundercomm Technology Co., Ltd. and its affiliates.
+ * You may not use, copy, distribute, modify, transmit in any form this file
+ * except in compliance with THUNDERCOMM in writing by applicable law.
+ *
+ * @Description: Implementation of the thumbnail motion detector.
+ * @version: 1.0
+ * @Author: Ricardo Lu<sheng.lu@thundercomm.com>
+ * @Date: 2026-10-17 22:48:31
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-17 22:48:31
+ */
+
+#include <string.h>
+#include <algorithm>
+
+#if defined(__x86_64__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "TSMotionGate.h"
+
+namespace ts {
+
+// Longer side of the thumbnail, in pixels.
+static const int THUMBNAIL_SIZE = 160;
+// Samples averaged along each side of a thumbnail block at most.
+static const int MAX_BLOCK_SAMPLES = 4;
+
+// Number of pixels of a row whose absolute difference is above thresh,
+// first and last get their columns and are left alone if there is none.
+static int diffRow(const uint8_t* cur, const uint8_t* ref, const int width, const int thresh,
+    int& first, int& last)
+{
+    int changed = 0;
+    int i = 0;
+#if defined(__x86_64__)
+    // |a - b| is the larger of the two saturated differences, a byte is above
+    // thresh if subtracting thresh with saturation leaves something.
+    const __m128i t = _mm_set1_epi8(static_cast<char>(thresh));
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= width; i += 16) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ref + i));
+        const __m128i d = _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+        const unsigned mask = ~_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_subs_epu8(d, t), zero)) & 0xFFFF;
+        if (mask) {
+            if (0 == changed) {
+                first = i + __builtin_ctz(mask);
+            }
+            last = i + 31 - __builtin_clz(mask);
+            changed += __builtin_popcount(mask);
+        }
+    }
+#elif defined(__aarch64__)
+    const uint8x16_t t = vdupq_n_u8(static_cast<uint8_t>(thresh));
+    for (; i + 16 <= width; i += 16) {
+        const uint8x16_t above = vcgtq_u8(vabdq_u8(vld1q_u8(cur + i), vld1q_u8(ref + i)), t);
+        if (vmaxvq_u8(above)) {
+            uint8_t lanes[16];
+            vst1q_u8(lanes, above);
+            for (int k = 0; k < 16; k++) {
+                if (lanes[k]) {
+                    if (0 == changed) {
+                        first = i + k;
+                    }
+                    last = i + k;
+                    changed++;
+                }
+            }
+        }
+    }
+#endif
+    for (; i < width; i++) {
+        const int d = cur[i] > ref[i] ? cur[i] - ref[i] : ref[i] - cur[i];
+        if (d > thresh) {
+            if (0 == changed) {
+                first = i;
+            }
+            last = i;
+            changed++;
+        }
+    }
+    return changed;
+}
+
+void TSMotionGate::configure(const TSRect_T<int>& area, const int format)
+{
+    m_area = area;
+    m_format = format;
+    m_valid = false;
+
+    m_yuv = TYPE_NV12 == format || TYPE_I420 == format;
+    if (m_yuv || TYPE_C1_U8 == format) {
+        m_pixelStep = 1;
+    } else if (TYPE_BGRX_U8 == format || TYPE_RGBX_U8 == format) {
+        m_pixelStep = 4;
+    } else {
+        m_pixelStep = 3;
+    }
+
+    // Square blocks, the partial ones on the right and bottom edges are kept.
+    const int longer = std::max(area.width, area.height);
+    m_block = std::max(1, (longer + THUMBNAIL_SIZE - 1) / THUMBNAIL_SIZE);
+    m_width = (area.width + m_block - 1) / m_block;
+    m_height = (area.height + m_block - 1) / m_block;
+    m_samples = std::min(m_block, MAX_BLOCK_SAMPLES);
+
+    // Samples spread evenly over each block, clamped to the area.
+    m_xSamples.resize(m_width * m_samples);
+    for (int k = 0; k < m_width; k++) {
+        for (int s = 0; s < m_samples; s++) {
+            const int x = std::min(k * m_block + (2 * s + 1) * m_block / (2 * m_samples), area.width - 1);
+            m_xSamples[k * m_samples + s] = x * m_pixelStep;
+        }
+    }
+    m_ySamples.resize(m_height * m_samples);
+    for (int j = 0; j < m_height; j++) {
+        for (int s = 0; s < m_samples; s++) {
+            m_ySamples[j * m_samples + s] =
+                std::min(j * m_block + (2 * s + 1) * m_block / (2 * m_samples), area.height - 1);
+        }
+    }
+
+    m_thumb.resize(m_width * m_height);
+    m_reference.resize(m_width * m_height);
+}
+
+void TSMotionGate::thumbnail(const ts::TSImgData& image)
+{
+    // Luma of the Y plane, or (c0 + 2 * c1 + c2) / 4 of packed pixels whatever their order.
+    const int stride = m_yuv ? image.planeStride(0) : image.stride();
+    const uint8_t* origin = image.data() + m_area.y * stride + m_area.x * m_pixelStep;
+    const int weight = m_samples * m_samples * (1 == m_pixelStep ? 1 : 4);
+
+    for (int j = 0; j < m_height; j++) {
+        uint8_t* dst = m_thumb.data() + j * m_width;
+        for (int k = 0; k < m_width; k++) {
+            int sum = 0;
+            for (int sy = 0; sy < m_samples; sy++) {
+                const uint8_t* row = origin + m_ySamples[j * m_samples + sy] * stride;
+                for (int sx = 0; sx < m_samples; sx++) {
+                    const uint8_t* p = row + m_xSamples[k * m_samples + sx];
+                    sum += 1 == m_pixelStep ? p[0] : p[0] + 2 * p[1] + p[2];
+                }
+            }
+            dst[k] = static_cast<uint8_t>((sum + weight / 2) / weight);
+        }
+    }
+}
+
+bool TSMotionGate::detect(const ts::TSImgData& image, const TSRect_T<int>& area, TSRect_T<int>& motion)
+{
+    motion = area;
+    const int format = image.format();
+    if (TYPE_BGR_F32 == format || TYPE_RGB_F32 == format || TYPE_C1_F32 == format ||
+        TYPE_UNKNOWN == format || area.empty()) {
+        m_valid = false;
+        return true;
+    }
+
+    if (area.x != m_area.x || area.y != m_area.y || area.width != m_area.width ||
+        area.height != m_area.height || format != m_format) {
+        configure(area, format);
+    }
+
+    thumbnail(image);
+    if (!m_valid) {
+        return true;
+    }
+
+    int changed = 0;
+    int x0 = m_width, y0 = m_height, x1 = -1, y1 = -1;
+    for (int j = 0; j < m_height; j++) {
+        int first = 0, last = 0;
+        const int n = diffRow(m_thumb.data() + j * m_width, m_reference.data() + j * m_width,
+            m_width, m_pixelThresh, first, last);
+        if (n > 0) {
+            changed += n;
+            x0 = std::min(x0, first);
+            x1 = std::max(x1, last);
+            y0 = std::min(y0, j);
+            y1 = j;
+        }
+    }
+
+    if (0 == changed || changed < m_minArea * m_width * m_height) {
+        return false;
+    }
+
+    // Changed blocks back to image pixels, the edge blocks may be partial.
+    const int right = std::min((x1 + 1) * m_block, area.width);
+    const int bottom = std::min((y1 + 1) * m_block, area.height);
+    motion = TSRect_T<int>(area.x + x0 * m_block, area.y + y0 * m_block,
+        right - x0 * m_block, bottom - y0 * m_block);
+    return true;
+}
+
+void TSMotionGate::accept(const TSRect_T<int>& region)
+{
+    if (m_thumb.empty() || m_area.empty()) {
+        return;
+    }
+
+    // Blocks whose centre is inside the region, a region reaching the edge of the area
+    // also covers the partial blocks there.
+    const int right = region.x + region.width - m_area.x;
+    const int bottom = region.y + region.height - m_area.y;
+    const int x0 = std::max(0, (region.x - m_area.x + m_block / 2) / m_block);
+    const int y0 = std::max(0, (region.y - m_area.y + m_block / 2) / m_block);
+    const int x1 = right >= m_area.width ? m_width : std::min(m_width, (right + m_block / 2) / m_block);
+    const int y1 = bottom >= m_area.height ? m_height : std::min(m_height, (bottom + m_block / 2) / m_block);
+
+    if (!m_valid) {
+        // The whole reference must be refreshed before it is used.
+        if (x0 > 0 || y0 > 0 || x1 < m_width || y1 < m_height) {
+            return;
+        }
+        m_valid = true;
+    }
+
+    for (int j = y0; j < y1; j++) {
+        if (x0 < x1) {
+            memcpy(m_reference.data() + j * m_width + x0, m_thumb.data() + j * m_width + x0, x1 - x0);
+        }
+    }
+}
+
+} // namespace ts
@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2012-2022
+ * All Rights Reserved by Thundercomm Technology Co., Ltd. and its affiliates.
+ * You may not use, copy, distribute, modify, transmit in any form this file
+ * except in compliance with THUNDERCOMM in writing by applicable law.
+ *
+ * @Description: Implementation of grid indexed greedy NMS.
+ * @version: 1.0
+ * @Author: Ricardo Lu<sheng.lu@thundercomm.com>
+ * @Date: 2026-10-17 17:05:18
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-17 17:05:18
+ */
+
+#include <algorithm>
+#include <climits>
+
+#include "TSNms.h"
+
+namespace ts {
+
+// Upper bound of grid cells, the cells grow instead for very spread out boxes.
+static const int MAX_GRID_CELLS = 4096;
+
+void TSNms::sortByConfidence(TSDetections& boxes)
+{
+    const float* confidence = boxes.confidence();
+    m_order.resize(boxes.size());
+    for (size_t i = 0; i < m_order.size(); i++) {
+        m_order[i] = static_cast<int>(i);
+    }
+    std::stable_sort(m_order.begin(), m_order.end(), [confidence] (int left, int right) {
+        return confidence[left] > confidence[right];
+    });
+
+    // Nothing to keep from the last frame, the arena isn't copied if it grows.
+    m_sorted.clear();
+    m_sorted.resize(boxes.size());
+    for (size_t i = 0; i < m_order.size(); i++) {
+        m_sorted.copy(i, boxes, m_order[i]);
+    }
+    boxes.swap(m_sorted);
+}
+
+void TSNms::buildGrid(const TSDetections& boxes, const float thresh)
+{
+    // Boxes cover the pixels [x, x + width] with the +1 convention of calcIoU.
+    const int* x = boxes.x();
+    const int* y = boxes.y();
+    const int* width = boxes.width();
+    const int* height = boxes.height();
+    int minX = INT_MAX, minY = INT_MAX, maxX = INT_MIN, maxY = INT_MIN;
+    long long sizeSum = 0;
+    for (size_t i = 0; i < boxes.size(); i++) {
+        minX = std::min(minX, x[i]);
+        minY = std::min(minY, y[i]);
+        maxX = std::max(maxX, x[i] + width[i]);
+        maxY = std::max(maxY, y[i] + height[i]);
+        sizeSum += std::max(width[i], height[i]);
+    }
+
+    m_originX = minX;
+    m_originY = minY;
+    const int spanX = maxX - minX + 1;
+    const int spanY = maxY - minY + 1;
+
+    if (thresh < 0.0f) {
+        // Even disjoint boxes have IoU above a negative threshold, test all pairs.
+        m_cellSize = std::max(spanX, spanY);
+    } else {
+        // About one cell per box side, so a typical box covers up to 4 cells.
+        m_cellSize = std::max(1, static_cast<int>(sizeSum / static_cast<long long>(boxes.size())));
+        while (static_cast<long long>(spanX / m_cellSize + 1) * (spanY / m_cellSize + 1) > MAX_GRID_CELLS) {
+            m_cellSize *= 2;
+        }
+    }
+
+    m_cols = (spanX - 1) / m_cellSize + 1;
+    m_rows = (spanY - 1) / m_cellSize + 1;
+
+    const size_t cells = static_cast<size_t>(m_cols) * m_rows;
+    if (m_cells.size() < cells) {
+        m_cells.resize(cells);
+    }
+    for (size_t i = 0; i < cells; i++) {
+        m_cells[i].clear();
+    }
+
+    m_seen.assign(boxes.size(), -1);
+}
+
+void TSNms::cellRange(const TSRect_T<int>& box, int& x0, int& y0, int& x1, int& y1) const
+{
+    x0 = (box.x - m_originX) / m_cellSize;
+    y0 = (box.y - m_originY) / m_cellSize;
+    x1 = (box.x + box.width - m_originX) / m_cellSize;
+    y1 = (box.y + box.height - m_originY) / m_cellSize;
+}
+
+bool TSNms::suppressed(const TSDetections& boxes, const int index, const float thresh)
+{
+    const TSRect_T<int> box = boxes.rect(index);
+    const int* label = boxes.label();
+    int x0, y0, x1, y1;
+    cellRange(box, x0, y0, x1, y1);
+
+    for (int cy = y0; cy <= y1; cy++) {
+        for (int cx = x0; cx <= x1; cx++) {
+            for (int k : m_cells[cy * m_cols + cx]) {
+                // A kept box covering several cells is only tested once.
+                if (m_seen[k] == index) {
+                    continue;
+                }
+                m_seen[k] = index;
+
+                if (m_classAware && label[k] != label[index]) {
+                    continue;
+                }
+
+                m_stats.comparisons++;
+                const TSRect_T<int> kept = boxes.rect(k);
+                if (calcIoU(&kept, &box) > thresh) {
+                    return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+void TSNms::run(TSDetections& boxes, const float thresh, const size_t maxKept)
+{
+    m_stats = NmsStats();
+    m_stats.candidates = boxes.size();
+    if (boxes.empty()) {
+        return;
+    }
+
+    sortByConfidence(boxes);
+    buildGrid(boxes, thresh);
+
+    // Kept boxes are compacted to the front, kept <= i so no candidate is overwritten
+    // before it is visited and the grid only refers to the compacted part.
+    size_t kept = 0;
+    for (size_t i = 0; i < boxes.size() && (0 == maxKept || kept < maxKept); i++) {
+        if (suppressed(boxes, static_cast<int>(i), thresh)) {
+            continue;
+        }
+
+        if (kept != i) {
+            boxes.copy(kept, boxes, i);
+        }
+
+        int x0, y0, x1, y1;
+        cellRange(boxes.rect(kept), x0, y0, x1, y1);
+        for (int cy = y0; cy <= y1; cy++) {
+            for (int cx = x0; cx <= x1; cx++) {
+                m_cells[cy * m_cols + cx].push_back(static_cast<int>(kept));
+            }
+        }
+        kept++;
+    }
+
+    boxes.truncate(kept);
+    m_stats.kept = kept;
+}
+
+} // namespace ts
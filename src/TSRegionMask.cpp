@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2012-2022
+ * All Rights Reserved by Thundercomm Technology Co., Ltd. and its affiliates.
+ * You may not use, copy, distribute, modify, transmit in any form this file
+ * except in compliance with THUNDERCOMM in writing by applicable law.
+ *
+ * @Description: Implementation of polygon region masks.
+ * @version: 1.0
+ * @Author: Ricardo Lu<sheng.lu@thundercomm.com>
+ * @Date: 2026-10-17 21:36:05
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-17 21:36:05
+ */
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#include "TSRegionMask.h"
+
+namespace ts {
+
+void TSRegionMask::setPolygons(const std::vector<TSPolygon>& include, const std::vector<TSPolygon>& exclude)
+{
+    m_include.clear();
+    m_exclude.clear();
+    // A polygon needs 3 vertices to cover anything.
+    for (const auto& polygon : include) {
+        if (polygon.size() >= 3) {
+            m_include.push_back(polygon);
+        }
+    }
+    for (const auto& polygon : exclude) {
+        if (polygon.size() >= 3) {
+            m_exclude.push_back(polygon);
+        }
+    }
+    m_valid = false;
+}
+
+bool TSRegionMask::update(const TSRect_T<int>& roi, const float scale, const int xOffset, const int yOffset,
+    const std::vector<int>& heights, const std::vector<int>& widths, const std::vector<float>& strides)
+{
+    if (!enabled()) {
+        return false;
+    }
+
+    if (m_valid && roi.x == m_roi.x && roi.y == m_roi.y && roi.width == m_roi.width &&
+        roi.height == m_roi.height && scale == m_scale && xOffset == m_xOffset &&
+        yOffset == m_yOffset && heights == m_heights && widths == m_widths && strides == m_strides) {
+        return false;
+    }
+
+    m_roi = roi;
+    m_scale = scale;
+    m_xOffset = xOffset;
+    m_yOffset = yOffset;
+    m_heights = heights;
+    m_widths = widths;
+    m_strides = strides;
+
+    m_masks.resize(heights.size());
+    for (size_t i = 0; i < heights.size(); i++) {
+        m_masks[i].assign(static_cast<size_t>(heights[i]) * widths[i], m_include.empty() ? 1 : 0);
+        rasterize(m_include, 1, i);
+        rasterize(m_exclude, 0, i);
+    }
+
+    m_valid = true;
+    return true;
+}
+
+void TSRegionMask::rasterize(const std::vector<TSPolygon>& polygons, const uint8_t value, const size_t head)
+{
+    const int height = m_heights[head];
+    const int width = m_widths[head];
+    const float stride = m_strides[head];
+    uint8_t* mask = m_masks[head].data();
+
+    for (const auto& polygon : polygons) {
+        for (int j = 0; j < height; j++) {
+            // Centre of the cell row, from network input to image coordinates.
+            const float y = ((j + 0.5f) * stride - m_yOffset) / m_scale + m_roi.y;
+
+            // Even-odd scanline: crossings of the edges with the row, half open in y
+            // so a vertex on the row is only counted once.
+            m_crossings.clear();
+            for (size_t e = 0; e < polygon.size(); e++) {
+                const TSPoint& a = polygon[e];
+                const TSPoint& b = polygon[(e + 1) % polygon.size()];
+                if ((a.y <= y && y < b.y) || (b.y <= y && y < a.y)) {
+                    m_crossings.push_back(a.x + (y - a.y) * (b.x - a.x) / (b.y - a.y));
+                }
+            }
+            std::sort(m_crossings.begin(), m_crossings.end());
+
+            // Cells whose centre x is in [x0, x1) of each inside span.
+            for (size_t c = 0; c + 1 < m_crossings.size(); c += 2) {
+                const float x0 = (m_crossings[c] - m_roi.x) * m_scale + m_xOffset;
+                const float x1 = (m_crossings[c + 1] - m_roi.x) * m_scale + m_xOffset;
+                const int k0 = std::max(0, static_cast<int>(ceilf(x0 / stride - 0.5f)));
+                const int k1 = std::min(width, static_cast<int>(ceilf(x1 / stride - 0.5f)));
+                if (k0 < k1) {
+                    memset(mask + j * width + k0, value, k1 - k0);
+                }
+            }
+        }
+    }
+}
+
+size_t TSRegionMask::activeCells(const size_t head) const
+{
+    const uint8_t* m = mask(head);
+    if (nullptr == m) {
+        return 0;
+    }
+    return std::count(m, m + m_masks[head].size(), 1);
+}
+
+} // namespace ts
@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2012-2022
+ * All Rights Reserved by Thundercomm Technology Co., Ltd. and its affiliates.
+ * You may not use, copy, distribute, modify, transmit in any form this file
+ * except in compliance with THUNDERCOMM in writing by applicable law.
+ *
+ * @Description: Implementation of the SORT style tracker.
+ * @version: 1.0
+ * @Author: Ricardo Lu<sheng.lu@thundercomm.com>
+ * @Date: 2026-10-17 23:37:12
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-17 23:37:12
+ */
+
+#include <math.h>
+#include <algorithm>
+
+#include "TSTracker.h"
+
+namespace ts {
+
+// Standard deviations relative to the box size: position noise and velocity noise per frame.
+static const float POSITION_NOISE = 1.0f / 20.0f;
+static const float VELOCITY_NOISE = 1.0f / 160.0f;
+
+void TSTracker::Filter::init(const float z, const float scale)
+{
+    p = z;
+    v = 0.0f;
+    // Unknown velocity at first.
+    p00 = (2 * POSITION_NOISE * scale) * (2 * POSITION_NOISE * scale);
+    p01 = 0.0f;
+    p11 = (10 * VELOCITY_NOISE * scale) * (10 * VELOCITY_NOISE * scale);
+}
+
+void TSTracker::Filter::predict(const float scale)
+{
+    // x' = F x, P' = F P F^t + Q with F = [1 1; 0 1].
+    p += v;
+    p00 += 2 * p01 + p11 + (POSITION_NOISE * scale) * (POSITION_NOISE * scale);
+    p01 += p11;
+    p11 += (VELOCITY_NOISE * scale) * (VELOCITY_NOISE * scale);
+}
+
+void TSTracker::Filter::update(const float z, const float scale)
+{
+    // Only the position is measured, H = [1 0].
+    const float s = p00 + (POSITION_NOISE * scale) * (POSITION_NOISE * scale);
+    const float k0 = p00 / s;
+    const float k1 = p01 / s;
+    const float y = z - p;
+    p += k0 * y;
+    v += k1 * y;
+    p11 -= k1 * p01;
+    p01 -= k0 * p01;
+    p00 -= k0 * p00;
+}
+
+TSRect_T<int> TSTracker::Track::rect() const
+{
+    const float width = std::max(1.0f, f[2].p);
+    const float height = std::max(1.0f, f[3].p);
+    return TSRect_T<int>(static_cast<int>(lroundf(f[0].p - width / 2)),
+        static_cast<int>(lroundf(f[1].p - height / 2)),
+        static_cast<int>(lroundf(width)), static_cast<int>(lroundf(height)));
+}
+
+void TSTracker::predict()
+{
+    for (auto& track : m_tracks) {
+        // Noises follow the size before the move.
+        const float width = std::max(1.0f, track.f[2].p);
+        const float height = std::max(1.0f, track.f[3].p);
+        track.f[0].predict(width);
+        track.f[1].predict(height);
+        track.f[2].predict(width);
+        track.f[3].predict(height);
+        track.age++;
+    }
+}
+
+void TSTracker::update(const TSDetections& detections)
+{
+    const int* label = detections.label();
+    const float* confidence = detections.confidence();
+
+    // Every pair of the same label overlapping enough, by decreasing IoU.
+    m_pairs.clear();
+    for (size_t t = 0; t < m_tracks.size(); t++) {
+        const TSRect_T<int> box = m_tracks[t].rect();
+        for (size_t d = 0; d < detections.size(); d++) {
+            if (label[d] != m_tracks[t].label) {
+                continue;
+            }
+            const TSRect_T<int> detection = detections.rect(d);
+            const float iou = calcIoU(&box, &detection);
+            if (iou >= m_iouThresh) {
+                m_pairs.push_back({iou, static_cast<int>(t), static_cast<int>(d)});
+            }
+        }
+    }
+    std::stable_sort(m_pairs.begin(), m_pairs.end(), [] (const Pair& left, const Pair& right) {
+        return left.iou > right.iou;
+    });
+
+    m_trackMatched.assign(m_tracks.size(), 0);
+    m_detectionMatched.assign(detections.size(), 0);
+    for (const auto& pair : m_pairs) {
+        if (m_trackMatched[pair.track] || m_detectionMatched[pair.detection]) {
+            continue;
+        }
+        m_trackMatched[pair.track] = 1;
+        m_detectionMatched[pair.detection] = 1;
+
+        Track& track = m_tracks[pair.track];
+        const TSRect_T<int> box = detections.rect(pair.detection);
+        const float width = std::max(1.0f, track.f[2].p);
+        const float height = std::max(1.0f, track.f[3].p);
+        track.f[0].update(box.x + box.width / 2.0f, width);
+        track.f[1].update(box.y + box.height / 2.0f, height);
+        track.f[2].update(box.width, width);
+        track.f[3].update(box.height, height);
+        track.score = confidence[pair.detection];
+        track.age = 0;
+        track.hits++;
+        track.misses = 0;
+    }
+
+    // Drop the tracks lost for too long, in place.
+    size_t kept = 0;
+    for (size_t t = 0; t < m_tracks.size(); t++) {
+        if (!m_trackMatched[t] && ++m_tracks[t].misses > m_maxMisses) {
+            continue;
+        }
+        if (kept != t) {
+            m_tracks[kept] = m_tracks[t];
+        }
+        kept++;
+    }
+    m_tracks.resize(kept);
+
+    for (size_t d = 0; d < detections.size(); d++) {
+        if (m_detectionMatched[d]) {
+            continue;
+        }
+        const TSRect_T<int> box = detections.rect(d);
+        Track track;
+        track.id = m_nextId++;
+        track.label = label[d];
+        track.score = confidence[d];
+        track.hits = 1;
+        track.f[0].init(box.x + box.width / 2.0f, std::max(1, box.width));
+        track.f[1].init(box.y + box.height / 2.0f, std::max(1, box.height));
+        track.f[2].init(box.width, std::max(1, box.width));
+        track.f[3].init(box.height, std::max(1, box.height));
+        m_tracks.push_back(track);
+    }
+}
+
+void TSTracker::output(TSDetections& boxes, std::vector<int>& ids) const
+{
+    boxes.clear();
+    ids.clear();
+    for (const auto& track : m_tracks) {
+        if (track.misses > 0 || track.hits < m_minHits) {
+            continue;
+        }
+        const TSRect_T<int> box = track.rect();
+        boxes.push_back(box.x, box.y, box.width, box.height,
+            track.score * powf(m_confidenceDecay, track.age), track.label);
+        ids.push_back(track.id);
+    }
+}
+
+float TSTracker::minConfidence() const
+{
+    float lowest = 1.0f;
+    for (const auto& track : m_tracks) {
+        if (track.misses > 0 || track.hits < m_minHits) {
+            continue;
+        }
+        lowest = std::min(lowest, powf(m_confidenceDecay, track.age));
+    }
+    return lowest;
+}
+
+} // namespace ts
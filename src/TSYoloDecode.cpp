@@ -0,0 +1,714 @@
+/*
+ * Copyright (c) 2012-2022
+ * All Rights Reserved by Thundercomm Technology Co., Ltd. and its affiliates.
+ * You may not use, copy, distribute, modify, transmit in any form this file
+ * except in compliance with THUNDERCOMM in writing by applicable law.
+ *
+ * @Description: Implementation of yolo head decode kernels.
+ * @version: 1.0
+ * @Author: Ricardo Lu<sheng.lu@thundercomm.com>
+ * @Date: 2026-10-17 16:12:40
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-17 16:12:40
+ */
+
+// Built with -ffp-contract=off: a fused multiply-add in one variant only
+// would break the bit-identical results between the variants.
+
+#include <math.h>
+#include <algorithm>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "TSYoloDecode.h"
+
+namespace ts {
+
+//------------------------------------------------------------------------------
+// Scalar reference.
+
+static int scanObjectnessScalar(const float* pred, int count, int channels, float thresh, int* index)
+{
+    const float* obj = pred + 4;
+    int found = 0;
+    for (int i = 0; i < count; i++) {
+        if (obj[i * channels] > thresh) {
+            index[found++] = i;
+        }
+    }
+    return found;
+}
+
+static void decodeBoxScalar(const float* pred, const float coef[4][4], float* box)
+{
+    for (int c = 0; c < 4; c++) {
+        box[c] = (pred[c] * pred[c] * coef[0][c] + pred[c] * coef[1][c] + coef[2][c]) * coef[3][c];
+    }
+}
+
+static float classMaxScalar(const float* cls, int count, int* label)
+{
+    float best = cls[0];
+    *label = 0;
+    for (int m = 1; m < count; m++) {
+        if (cls[m] > best) {
+            best = cls[m];
+            *label = m;
+        }
+    }
+    return best;
+}
+
+static int classFilterScalar(const float* cls, int count, float objectness, float thresh,
+    int* labels, float* scores)
+{
+    int found = 0;
+    for (int m = 0; m < count; m++) {
+        float score = objectness * cls[m];
+        if (score > thresh) {
+            labels[found] = m;
+            scores[found] = score;
+            found++;
+        }
+    }
+    return found;
+}
+
+static const YoloKernels KERNELS_SCALAR = {
+    "scalar", scanObjectnessScalar, decodeBoxScalar, classMaxScalar, classFilterScalar
+};
+
+// First index holding value, the value is known to be in cls.
+static inline int firstIndexOf(const float* cls, int count, float value)
+{
+    for (int m = 0; m < count; m++) {
+        if (cls[m] == value) {
+            return m;
+        }
+    }
+    return 0;
+}
+
+#if defined(__x86_64__)
+//------------------------------------------------------------------------------
+// x86: SSE2 is part of x86-64, AVX2 and AVX-512 are selected at runtime.
+
+static void decodeBoxSse(const float* pred, const float coef[4][4], float* box)
+{
+    __m128 v = _mm_loadu_ps(pred);
+    __m128 t = _mm_mul_ps(_mm_mul_ps(v, v), _mm_loadu_ps(coef[0]));
+    t = _mm_add_ps(t, _mm_mul_ps(v, _mm_loadu_ps(coef[1])));
+    t = _mm_add_ps(t, _mm_loadu_ps(coef[2]));
+    _mm_storeu_ps(box, _mm_mul_ps(t, _mm_loadu_ps(coef[3])));
+}
+
+__attribute__((target("avx2")))
+static int scanObjectnessAvx2(const float* pred, int count, int channels, float thresh, int* index)
+{
+    const float* obj = pred + 4;
+    const __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+        _mm256_set1_epi32(channels));
+    const __m256 t = _mm256_set1_ps(thresh);
+    int found = 0;
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 v = _mm256_i32gather_ps(obj + i * channels, offsets, 4);
+        unsigned mask = _mm256_movemask_ps(_mm256_cmp_ps(v, t, _CMP_GT_OQ));
+        while (mask) {
+            index[found++] = i + __builtin_ctz(mask);
+            mask &= mask - 1;
+        }
+    }
+    for (; i < count; i++) {
+        if (obj[i * channels] > thresh) {
+            index[found++] = i;
+        }
+    }
+    return found;
+}
+
+__attribute__((target("avx2")))
+static float classMaxAvx2(const float* cls, int count, int* label)
+{
+    if (count < 8) {
+        return classMaxScalar(cls, count, label);
+    }
+
+    __m256 vmax = _mm256_loadu_ps(cls);
+    int m = 8;
+    for (; m + 8 <= count; m += 8) {
+        vmax = _mm256_max_ps(vmax, _mm256_loadu_ps(cls + m));
+    }
+    __m128 r = _mm_max_ps(_mm256_castps256_ps128(vmax), _mm256_extractf128_ps(vmax, 1));
+    r = _mm_max_ps(r, _mm_movehl_ps(r, r));
+    r = _mm_max_ss(r, _mm_shuffle_ps(r, r, 1));
+    float best = _mm_cvtss_f32(r);
+    for (; m < count; m++) {
+        best = std::max(best, cls[m]);
+    }
+
+    *label = firstIndexOf(cls, count, best);
+    return best;
+}
+
+__attribute__((target("avx2")))
+static int classFilterAvx2(const float* cls, int count, float objectness, float thresh,
+    int* labels, float* scores)
+{
+    const __m256 obj = _mm256_set1_ps(objectness);
+    const __m256 t = _mm256_set1_ps(thresh);
+    int found = 0;
+    int m = 0;
+    for (; m + 8 <= count; m += 8) {
+        __m256 s = _mm256_mul_ps(obj, _mm256_loadu_ps(cls + m));
+        unsigned mask = _mm256_movemask_ps(_mm256_cmp_ps(s, t, _CMP_GT_OQ));
+        if (mask) {
+            float lane[8];
+            _mm256_storeu_ps(lane, s);
+            while (mask) {
+                int b = __builtin_ctz(mask);
+                labels[found] = m + b;
+                scores[found] = lane[b];
+                found++;
+                mask &= mask - 1;
+            }
+        }
+    }
+    for (; m < count; m++) {
+        float score = objectness * cls[m];
+        if (score > thresh) {
+            labels[found] = m;
+            scores[found] = score;
+            found++;
+        }
+    }
+    return found;
+}
+
+static const YoloKernels KERNELS_AVX2 = {
+    "avx2", scanObjectnessAvx2, decodeBoxSse, classMaxAvx2, classFilterAvx2
+};
+
+__attribute__((target("avx512f")))
+static int scanObjectnessAvx512(const float* pred, int count, int channels, float thresh, int* index)
+{
+    const float* obj = pred + 4;
+    const __m512i lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    const __m512i offsets = _mm512_mullo_epi32(lanes, _mm512_set1_epi32(channels));
+    const __m512 t = _mm512_set1_ps(thresh);
+    int found = 0;
+    for (int i = 0; i < count; i += 16) {
+        __mmask16 valid = count - i >= 16 ? 0xFFFF : static_cast<__mmask16>((1u << (count - i)) - 1);
+        __m512 v = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), valid, offsets, obj + i * channels, 4);
+        __mmask16 mask = _mm512_mask_cmp_ps_mask(valid, v, t, _CMP_GT_OQ);
+        _mm512_mask_compressstoreu_epi32(index + found, mask,
+            _mm512_add_epi32(lanes, _mm512_set1_epi32(i)));
+        found += __builtin_popcount(mask);
+    }
+    return found;
+}
+
+__attribute__((target("avx512f")))
+static float classMaxAvx512(const float* cls, int count, int* label)
+{
+    __m512 vmax = _mm512_set1_ps(-__builtin_inff());
+    for (int m = 0; m < count; m += 16) {
+        __mmask16 valid = count - m >= 16 ? 0xFFFF : static_cast<__mmask16>((1u << (count - m)) - 1);
+        vmax = _mm512_max_ps(vmax, _mm512_mask_loadu_ps(vmax, valid, cls + m));
+    }
+    float best = _mm512_reduce_max_ps(vmax);
+
+    *label = firstIndexOf(cls, count, best);
+    return best;
+}
+
+__attribute__((target("avx512f")))
+static int classFilterAvx512(const float* cls, int count, float objectness, float thresh,
+    int* labels, float* scores)
+{
+    const __m512i lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    const __m512 obj = _mm512_set1_ps(objectness);
+    const __m512 t = _mm512_set1_ps(thresh);
+    int found = 0;
+    for (int m = 0; m < count; m += 16) {
+        __mmask16 valid = count - m >= 16 ? 0xFFFF : static_cast<__mmask16>((1u << (count - m)) - 1);
+        __m512 s = _mm512_mul_ps(obj, _mm512_maskz_loadu_ps(valid, cls + m));
+        __mmask16 mask = _mm512_mask_cmp_ps_mask(valid, s, t, _CMP_GT_OQ);
+        if (mask) {
+            _mm512_mask_compressstoreu_epi32(labels + found, mask,
+                _mm512_add_epi32(lanes, _mm512_set1_epi32(m)));
+            _mm512_mask_compressstoreu_ps(scores + found, mask, s);
+            found += __builtin_popcount(mask);
+        }
+    }
+    return found;
+}
+
+static const YoloKernels KERNELS_AVX512 = {
+    "avx512", scanObjectnessAvx512, decodeBoxSse, classMaxAvx512, classFilterAvx512
+};
+
+#elif defined(__aarch64__)
+//------------------------------------------------------------------------------
+// aarch64: NEON is always there.
+
+static int scanObjectnessNeon(const float* pred, int count, int channels, float thresh, int* index)
+{
+    const float* obj = pred + 4;
+    const float32x4_t t = vdupq_n_f32(thresh);
+    int found = 0;
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const float* p = obj + i * channels;
+        float32x4_t v = vdupq_n_f32(p[0]);
+        v = vsetq_lane_f32(p[channels], v, 1);
+        v = vsetq_lane_f32(p[2 * channels], v, 2);
+        v = vsetq_lane_f32(p[3 * channels], v, 3);
+        uint32x4_t gt = vcgtq_f32(v, t);
+        if (0 == vmaxvq_u32(gt)) {
+            continue;
+        }
+        if (vgetq_lane_u32(gt, 0)) index[found++] = i;
+        if (vgetq_lane_u32(gt, 1)) index[found++] = i + 1;
+        if (vgetq_lane_u32(gt, 2)) index[found++] = i + 2;
+        if (vgetq_lane_u32(gt, 3)) index[found++] = i + 3;
+    }
+    for (; i < count; i++) {
+        if (obj[i * channels] > thresh) {
+            index[found++] = i;
+        }
+    }
+    return found;
+}
+
+static void decodeBoxNeon(const float* pred, const float coef[4][4], float* box)
+{
+    float32x4_t v = vld1q_f32(pred);
+    float32x4_t t = vmulq_f32(vmulq_f32(v, v), vld1q_f32(coef[0]));
+    t = vaddq_f32(t, vmulq_f32(v, vld1q_f32(coef[1])));
+    t = vaddq_f32(t, vld1q_f32(coef[2]));
+    vst1q_f32(box, vmulq_f32(t, vld1q_f32(coef[3])));
+}
+
+static float classMaxNeon(const float* cls, int count, int* label)
+{
+    if (count < 4) {
+        return classMaxScalar(cls, count, label);
+    }
+
+    float32x4_t vmax = vld1q_f32(cls);
+    int m = 4;
+    for (; m + 4 <= count; m += 4) {
+        vmax = vmaxq_f32(vmax, vld1q_f32(cls + m));
+    }
+    float best = vmaxvq_f32(vmax);
+    for (; m < count; m++) {
+        best = std::max(best, cls[m]);
+    }
+
+    *label = firstIndexOf(cls, count, best);
+    return best;
+}
+
+static int classFilterNeon(const float* cls, int count, float objectness, float thresh,
+    int* labels, float* scores)
+{
+    const float32x4_t t = vdupq_n_f32(thresh);
+    int found = 0;
+    int m = 0;
+    for (; m + 4 <= count; m += 4) {
+        float32x4_t s = vmulq_n_f32(vld1q_f32(cls + m), objectness);
+        if (0 == vmaxvq_u32(vcgtq_f32(s, t))) {
+            continue;
+        }
+        float lane[4];
+        vst1q_f32(lane, s);
+        for (int b = 0; b < 4; b++) {
+            if (lane[b] > thresh) {
+                labels[found] = m + b;
+                scores[found] = lane[b];
+                found++;
+            }
+        }
+    }
+    for (; m < count; m++) {
+        float score = objectness * cls[m];
+        if (score > thresh) {
+            labels[found] = m;
+            scores[found] = score;
+            found++;
+        }
+    }
+    return found;
+}
+
+static const YoloKernels KERNELS_NEON = {
+    "neon", scanObjectnessNeon, decodeBoxNeon, classMaxNeon, classFilterNeon
+};
+
+#endif
+
+//------------------------------------------------------------------------------
+
+std::vector<const YoloKernels*> yoloKernelsAvailable()
+{
+    std::vector<const YoloKernels*> kernels = {&KERNELS_SCALAR};
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        kernels.push_back(&KERNELS_AVX2);
+    }
+    if (__builtin_cpu_supports("avx512f")) {
+        kernels.push_back(&KERNELS_AVX512);
+    }
+#elif defined(__aarch64__)
+    kernels.push_back(&KERNELS_NEON);
+#endif
+    return kernels;
+}
+
+const YoloKernels& yoloKernels()
+{
+    static const YoloKernels* best = yoloKernelsAvailable().back();
+    return *best;
+}
+
+// Threshold of the c-th allowed class, negative ones fall back to the global threshold.
+static inline float classThreshold(const YoloDecodeParams& params, size_t c)
+{
+    return params.classThresh[c] < 0.0f ? params.confThresh : params.classThresh[c];
+}
+
+// Score an anchor on the allowed classes only, the other class channels are never read.
+static int filterAllowedClasses(const float* cls, float objectness, const YoloDecodeParams& params,
+    const bool bestClassOnly, int* labels, float* scores)
+{
+    int found = 0;
+    for (size_t c = 0; c < params.classes.size(); c++) {
+        const int label = params.classes[c];
+        const float score = objectness * cls[label];
+        if (score <= classThreshold(params, c)) {
+            continue;
+        }
+
+        if (!bestClassOnly) {
+            labels[found] = label;
+            scores[found] = score;
+            found++;
+        } else if (0 == found || score > scores[0]) {
+            labels[0] = label;
+            scores[0] = score;
+            found = 1;
+        }
+    }
+    return found;
+}
+
+// Score one anchor which passed the objectness scan, returns the number of labels above their threshold.
+static int scoreAnchor(const YoloKernels& kernels, const YoloDecodeParams& params, const int classes,
+    const float* pred, const bool bestClassOnly, int* labels, float* scores)
+{
+    const float objectness = pred[4];
+
+    if (!params.classes.empty()) {
+        return filterAllowedClasses(pred + 5, objectness, params, bestClassOnly, labels, scores);
+    }
+
+    int label;
+    const float best = objectness * kernels.classMax(pred + 5, classes, &label);
+    if (best <= params.confThresh) {
+        return 0;
+    }
+
+    if (bestClassOnly) {
+        labels[0] = label;
+        scores[0] = best;
+        return 1;
+    }
+    return kernels.classFilter(pred + 5, classes, objectness, params.confThresh, labels, scores);
+}
+
+// Score one anchor which passed the objectness scan and append its boxes, n is its index in the head.
+static void decodeAnchor(const YoloKernels& kernels, const YoloHead& head, const YoloDecodeParams& params,
+    const float* pred, const int n, float coef[4][4], int* labels, float* scores,
+    std::vector<YoloCandidate>& out)
+{
+    const int found = scoreAnchor(kernels, params, head.channels - 5, pred, params.bestClassOnly,
+        labels, scores);
+    if (0 == found) {
+        return;
+    }
+
+    int l = n % head.anchors;
+    int k = (n / head.anchors) % head.width;
+    int j = n / head.anchors / head.width;
+    coef[2][0] = k - 0.5f;
+    coef[2][1] = j + head.firstRow - 0.5f;
+    coef[3][2] = head.anchorGrid[l * 2];
+    coef[3][3] = head.anchorGrid[l * 2 + 1];
+
+    float box[4];
+    kernels.decodeBox(pred, coef, box);
+
+    for (int m = 0; m < found; m++) {
+        out.push_back({box[0], box[1], box[2], box[3], scores[m], labels[m]});
+    }
+}
+
+// Call visit(pred, n) for every anchor of the head whose objectness can reach a threshold,
+// pred holds its float channels and n is its index in the head. Masked cells are skipped.
+template <typename Visitor>
+static void forEachSurvivor(const YoloKernels& kernels, const YoloHead& head,
+    const YoloDecodeParams& params, Visitor visit)
+{
+    // Anchors are scanned in blocks so that the survivor indexes stay on the stack.
+    static const int SCAN_BLOCK = 256;
+    int index[SCAN_BLOCK];
+
+    // Per thread scratch, so decoding frame after frame doesn't allocate.
+    thread_local std::vector<float> dequantized;
+
+    // Scores are objectness * class probability with class probability <= 1,
+    // so an anchor can only produce a box if its objectness beats the lowest threshold.
+    float minThresh = params.classes.empty() ? params.confThresh : classThreshold(params, 0);
+    for (size_t c = 1; c < params.classes.size(); c++) {
+        minThresh = std::min(minThresh, classThreshold(params, c));
+    }
+    const float objThresh = std::max(0.001f, minThresh);
+
+    // TF8 head: the objectness is compared as uint8 against the smallest code whose
+    // dequantized value passes, only the channels of the survivors are dequantized.
+    float table[256];
+    int qThresh = 256;
+    if (nullptr != head.qdata) {
+        for (int q = 255; q >= 0; q--) {
+            table[q] = (q - head.qoffset) * head.qstep;
+            if (table[q] > objThresh) {
+                qThresh = q;
+            }
+        }
+        if (head.qstep <= 0.0f || qThresh > 255) {
+            return;
+        }
+        dequantized.resize(head.channels);
+    }
+
+    // Scan the runs of consecutive unmasked cells, a single run without a mask.
+    const int cells = head.height * head.width;
+    int runEnd = 0;
+    while (runEnd < cells) {
+        int runBegin = runEnd;
+        if (nullptr != head.cellMask) {
+            while (runBegin < cells && 0 == head.cellMask[runBegin]) {
+                runBegin++;
+            }
+            runEnd = runBegin;
+            while (runEnd < cells && 0 != head.cellMask[runEnd]) {
+                runEnd++;
+            }
+        } else {
+            runEnd = cells;
+        }
+
+        const int last = runEnd * head.anchors;
+        if (nullptr == head.qdata) {
+            for (int base = runBegin * head.anchors; base < last; base += SCAN_BLOCK) {
+                const float* block = head.data + static_cast<size_t>(base) * head.channels;
+                int count = kernels.scanObjectness(block, std::min(SCAN_BLOCK, last - base),
+                    head.channels, objThresh, index);
+
+                for (int i = 0; i < count; i++) {
+                    visit(block + static_cast<size_t>(index[i]) * head.channels, base + index[i]);
+                }
+            }
+            continue;
+        }
+
+        float* pred = dequantized.data();
+        const uint8_t* objectness = head.qdata + 4;
+        for (int n = runBegin * head.anchors; n < last; n++) {
+            if (objectness[static_cast<size_t>(n) * head.channels] < qThresh) {
+                continue;
+            }
+
+            const uint8_t* q = head.qdata + static_cast<size_t>(n) * head.channels;
+            for (int c = 0; c < 5; c++) {
+                pred[c] = table[q[c]];
+            }
+            if (params.classes.empty()) {
+                for (int c = 5; c < head.channels; c++) {
+                    pred[c] = table[q[c]];
+                }
+            } else {
+                for (int label : params.classes) {
+                    pred[5 + label] = table[q[5 + label]];
+                }
+            }
+
+            visit(pred, n);
+        }
+    }
+}
+
+void decodeYoloHead(const YoloKernels& kernels, const YoloHead& head, const YoloDecodeParams& params,
+    std::vector<YoloCandidate>& out)
+{
+    const int classes = head.channels - 5;
+    thread_local std::vector<int> labels;
+    thread_local std::vector<float> scores;
+    labels.resize(classes);
+    scores.resize(classes);
+
+    // x, y: (v * 2 - 0.5 + grid) * stride, w, h: v * v * 4 * anchor.
+    float coef[4][4] = {
+        {0, 0, 4, 4},
+        {2, 2, 0, 0},
+        {0, 0, 0, 0},
+        {head.stride, head.stride, 0, 0},
+    };
+
+    forEachSurvivor(kernels, head, params, [&] (const float* pred, int n) {
+        decodeAnchor(kernels, head, params, pred, n, coef, labels.data(), scores.data(), out);
+    });
+}
+
+void scoreYoloHead(const YoloKernels& kernels, const YoloHead& head, const YoloDecodeParams& params,
+    YoloScoreMap& map)
+{
+    const int classes = head.channels - 5;
+    thread_local std::vector<int> labels;
+    thread_local std::vector<float> scores;
+    labels.resize(classes);
+    scores.resize(classes);
+
+    // Only the rows of this band are written, bands of one head can be scored in parallel.
+    const size_t first = static_cast<size_t>(head.firstRow) * map.width;
+    const size_t cells = static_cast<size_t>(head.height) * head.width;
+    std::fill(map.score.begin() + first, map.score.begin() + first + cells, 0.0f);
+    std::fill(map.label.begin() + first, map.label.begin() + first + cells, -1);
+
+    float* cellScore = map.score.data() + first;
+    int* cellLabel = map.label.data() + first;
+    forEachSurvivor(kernels, head, params, [&] (const float* pred, int n) {
+        if (0 == scoreAnchor(kernels, params, classes, pred, true, labels.data(), scores.data())) {
+            return;
+        }
+        const int cell = n / head.anchors;
+        if (scores[0] > cellScore[cell]) {
+            cellScore[cell] = scores[0];
+            cellLabel[cell] = labels[0];
+        }
+    });
+}
+
+// Strict total order of the cells: higher score first, then lower map and cell index.
+static inline bool beats(float score, int map, int cell, float otherScore, int otherMap, int otherCell)
+{
+    if (score != otherScore) {
+        return score > otherScore;
+    }
+    return map != otherMap ? map < otherMap : cell < otherCell;
+}
+
+void findYoloPeaks(const std::vector<YoloScoreMap>& maps, const bool classAware,
+    std::vector<YoloPeak>& peaks)
+{
+    peaks.clear();
+    for (int m = 0; m < static_cast<int>(maps.size()); m++) {
+        const YoloScoreMap& map = maps[m];
+        for (int j = 0; j < map.height; j++) {
+            for (int k = 0; k < map.width; k++) {
+                const int cell = j * map.width + k;
+                const float score = map.score[cell];
+                if (score <= 0.0f) {
+                    continue;
+                }
+
+                const int label = map.label[cell];
+                const float cx = (k + 0.5f) * map.stride;
+                const float cy = (j + 0.5f) * map.stride;
+
+                // Compare with the cells of every map whose centre is at most one cell of
+                // the coarser map away: the 3x3 neighbourhood on the same map and the
+                // overlapping cells on the others, which see this cell the same way.
+                bool peak = true;
+                for (int o = 0; o < static_cast<int>(maps.size()) && peak; o++) {
+                    const YoloScoreMap& other = maps[o];
+                    const float radius = std::max(map.stride, other.stride);
+                    const int k0 = std::max(0, static_cast<int>(ceilf((cx - radius) / other.stride - 0.5f)));
+                    const int k1 = std::min(other.width - 1, static_cast<int>(floorf((cx + radius) / other.stride - 0.5f)));
+                    const int j0 = std::max(0, static_cast<int>(ceilf((cy - radius) / other.stride - 0.5f)));
+                    const int j1 = std::min(other.height - 1, static_cast<int>(floorf((cy + radius) / other.stride - 0.5f)));
+
+                    for (int y = j0; y <= j1 && peak; y++) {
+                        for (int x = k0; x <= k1; x++) {
+                            const int c = y * other.width + x;
+                            if ((o == m && c == cell) || (classAware && other.label[c] != label)) {
+                                continue;
+                            }
+                            if (beats(other.score[c], o, c, score, m, cell)) {
+                                peak = false;
+                                break;
+                            }
+                        }
+                    }
+                }
+
+                if (peak) {
+                    peaks.push_back({cx, cy, score, label});
+                }
+            }
+        }
+    }
+}
+
+void splitYoloHeads(const std::vector<YoloHead>& heads, const int cellsPerBand,
+    std::vector<YoloHead>& bands)
+{
+    bands.clear();
+    for (const auto& head : heads) {
+        const int cells = head.height * head.width;
+        const int count = std::max(1, (cells + cellsPerBand - 1) / std::max(1, cellsPerBand));
+        const int rows = (head.height + count - 1) / count;
+
+        for (int row = 0; row < head.height; row += rows) {
+            const size_t offset = static_cast<size_t>(row) * head.width * head.anchors * head.channels;
+            YoloHead band = head;
+            band.data = head.data ? head.data + offset : nullptr;
+            band.qdata = head.qdata ? head.qdata + offset : nullptr;
+            band.cellMask = head.cellMask ? head.cellMask + static_cast<size_t>(row) * head.width : nullptr;
+            band.firstRow = head.firstRow + row;
+            band.height = std::min(rows, head.height - row);
+            bands.push_back(band);
+        }
+    }
+}
+
+void keepTopCandidates(std::vector<YoloCandidate>& candidates, const size_t topK)
+{
+    if (0 == topK || candidates.size() <= topK) {
+        return;
+    }
+
+    // Min-heap on score: the front is the worst of the topK best seen so far.
+    auto worse = [] (const YoloCandidate& left, const YoloCandidate& right) {
+        return left.score > right.score;
+    };
+
+    auto heapEnd = candidates.begin() + topK;
+    std::make_heap(candidates.begin(), heapEnd, worse);
+    for (auto it = heapEnd; it != candidates.end(); ++it) {
+        if (it->score > candidates.front().score) {
+            std::pop_heap(candidates.begin(), heapEnd, worse);
+            *(heapEnd - 1) = *it;
+            std::push_heap(candidates.begin(), heapEnd, worse);
+        }
+    }
+    candidates.resize(topK);
+}
+
+} // namespace ts
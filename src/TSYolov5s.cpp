@@ -41,6 +41,101 @@ bool TSObjectDetection::Init(const std::string& model_path, const runtime_t runt
     }
 }
 
+bool TSObjectDetection::InitShared(const TSObjectDetection& other)
+{
+    if (nullptr == impl || nullptr == other.impl) {
+        TS_ERROR_LOG("TSObjectDetection::InitShared failed because incompleted initialization!");
+        return false;
+    }
+
+    if (IsInitialized() && !static_cast<TSObjectDetectionImpl*>(impl)->DeInitialize()) {
+        return false;
+    }
+    return static_cast<TSObjectDetectionImpl*>(impl)->InitializeShared(
+        *static_cast<const TSObjectDetectionImpl*>(other.impl));
+}
+
+bool TSObjectDetection::SetEngineCount(const int count)
+{
+    if (nullptr != impl) {
+        return static_cast<TSObjectDetectionImpl*>(impl)->SetEngineCount(count);
+    } else {
+        TS_ERROR_LOG("TSObjectDetection::SetEngineCount failed because incompleted initialization!");
+        return false;
+    }
+}
+
+bool TSObjectDetection::GetEngineStats(ts::EngineStats& stats)
+{
+    if (nullptr != impl && IsInitialized()) {
+        return static_cast<TSObjectDetectionImpl*>(impl)->GetEngineStats(stats);
+    } else {
+        TS_ERROR_LOG("TSObjectDetection::GetEngineStats failed because incompleted initialization!");
+        return false;
+    }
+}
+
+bool TSObjectDetection::SetRegions(const std::vector<std::vector<ts::TSPoint> >& include,
+    const std::vector<std::vector<ts::TSPoint> >& exclude)
+{
+    if (nullptr != impl) {
+        return static_cast<TSObjectDetectionImpl*>(impl)->SetRegions(include, exclude);
+    } else {
+        TS_ERROR_LOG("TSObjectDetection::SetRegions failed because incompleted initialization!");
+        return false;
+    }
+}
+
+bool TSObjectDetection::SetObjectSize(const int min_size, const int max_size)
+{
+    if (nullptr != impl) {
+        return static_cast<TSObjectDetectionImpl*>(impl)->SetObjectSize(min_size, max_size);
+    } else {
+        TS_ERROR_LOG("TSObjectDetection::SetObjectSize failed because incompleted initialization!");
+        return false;
+    }
+}
+
+bool TSObjectDetection::SetInputSize(const int width, const int height)
+{
+    if (nullptr != impl) {
+        return static_cast<TSObjectDetectionImpl*>(impl)->SetInputSize(width, height);
+    } else {
+        TS_ERROR_LOG("TSObjectDetection::SetInputSize failed because incompleted initialization!");
+        return false;
+    }
+}
+
+bool TSObjectDetection::SetBatchSize(const int batch)
+{
+    if (nullptr != impl) {
+        return static_cast<TSObjectDetectionImpl*>(impl)->SetBatchSize(batch);
+    } else {
+        TS_ERROR_LOG("TSObjectDetection::SetBatchSize failed because incompleted initialization!");
+        return false;
+    }
+}
+
+bool TSObjectDetection::SetInputEncoding(const encoding_t encoding)
+{
+    if (nullptr != impl) {
+        return static_cast<TSObjectDetectionImpl*>(impl)->SetInputEncoding(encoding);
+    } else {
+        TS_ERROR_LOG("TSObjectDetection::SetInputEncoding failed because incompleted initialization!");
+        return false;
+    }
+}
+
+bool TSObjectDetection::SetOutputEncoding(const encoding_t encoding)
+{
+    if (nullptr != impl) {
+        return static_cast<TSObjectDetectionImpl*>(impl)->SetOutputEncoding(encoding);
+    } else {
+        TS_ERROR_LOG("TSObjectDetection::SetOutputEncoding failed because incompleted initialization!");
+        return false;
+    }
+}
+
 bool TSObjectDetection::Deinit()
 {
     if (nullptr != impl && IsInitialized()) {
@@ -67,6 +162,38 @@ bool TSObjectDetection::Detect(const ts::TSImgData& image, std::vector<ts::Objec
     }
 }
 
+bool TSObjectDetection::Detect(const ts::TSImgData& image, ts::DetectionView& detections)
+{
+    if (nullptr != impl && IsInitialized()) {
+        return static_cast<TSObjectDetectionImpl*>(impl)->Detect(image, detections);
+    } else {
+        TS_ERROR_LOG("TSObjectDetection::Detect failed caused by incompleted initialization!");
+        return false;
+    }
+}
+
+bool TSObjectDetection::Detect(const std::vector<ts::TSImgData>& images,
+    std::vector<std::vector<ts::ObjectData> >& results)
+{
+    if (nullptr != impl && IsInitialized()) {
+        return static_cast<TSObjectDetectionImpl*>(impl)->Detect(images, results);
+    } else {
+        TS_ERROR_LOG("TSObjectDetection::Detect failed caused by incompleted initialization!");
+        return false;
+    }
+}
+
+bool TSObjectDetection::Count(const ts::TSImgData& image, std::vector<int>& counts,
+    ts::DensityMap* density)
+{
+    if (nullptr != impl && IsInitialized()) {
+        return static_cast<TSObjectDetectionImpl*>(impl)->Count(image, counts, density);
+    } else {
+        TS_ERROR_LOG("TSObjectDetection::Count failed caused by incompleted initialization!");
+        return false;
+    }
+}
+
 bool TSObjectDetection::SetScoreThreshold(const float& conf_thresh, const float& nms_thresh)
 {
     if (nullptr != impl) {
@@ -87,4 +214,179 @@ bool TSObjectDetection::SetROI(const ts::TSRect_T<int>& roi)
     }
 }
 
+bool TSObjectDetection::SetROIs(const std::vector<ts::TSRect_T<int> >& rois)
+{
+    if (nullptr != impl) {
+        return static_cast<TSObjectDetectionImpl*>(impl)->SetROIs(rois);
+    } else {
+        TS_ERROR_LOG("TSObjectDetection::SetROIs failed because incompleted initialization!");
+        return false;
+    }
+}
+
+bool TSObjectDetection::SetInterpolation(const interp_t interp)
+{
+    if (nullptr != impl) {
+        return static_cast<TSObjectDetectionImpl*>(impl)->SetInterpolation(interp);
+    } else {
+        TS_ERROR_LOG("TSObjectDetection::SetInterpolation failed because incompleted initialization!");
+        return false;
+    }
+}
+
+bool TSObjectDetection::SetPreProcessThreads(const int threads)
+{
+    if (nullptr != impl) {
+        return static_cast<TSObjectDetectionImpl*>(impl)->SetPreProcessThreads(threads);
+    } else {
+        TS_ERROR_LOG("TSObjectDetection::SetPreProcessThreads failed because incompleted initialization!");
+        return false;
+    }
+}
+
+bool TSObjectDetection::SetPostProcessThreads(const int threads)
+{
+    if (nullptr != impl) {
+        return static_cast<TSObjectDetectionImpl*>(impl)->SetPostProcessThreads(threads);
+    } else {
+        TS_ERROR_LOG("TSObjectDetection::SetPostProcessThreads failed because incompleted initialization!");
+        return false;
+    }
+}
+
+bool TSObjectDetection::SetDetectionLimits(const int top_k, const int max_detections)
+{
+    if (nullptr != impl) {
+        return static_cast<TSObjectDetectionImpl*>(impl)->SetTopK(top_k) &&
+            static_cast<TSObjectDetectionImpl*>(impl)->SetMaxDetections(max_detections);
+    } else {
+        TS_ERROR_LOG("TSObjectDetection::SetDetectionLimits failed because incompleted initialization!");
+        return false;
+    }
+}
+
+bool TSObjectDetection::SetBestClassOnly(const bool best_class_only)
+{
+    if (nullptr != impl) {
+        return static_cast<TSObjectDetectionImpl*>(impl)->SetBestClassOnly(best_class_only);
+    } else {
+        TS_ERROR_LOG("TSObjectDetection::SetBestClassOnly failed because incompleted initialization!");
+        return false;
+    }
+}
+
+bool TSObjectDetection::SetClasses(const std::vector<int>& classes, const std::vector<float>& conf_thresh)
+{
+    if (nullptr != impl) {
+        return static_cast<TSObjectDetectionImpl*>(impl)->SetClasses(classes, conf_thresh);
+    } else {
+        TS_ERROR_LOG("TSObjectDetection::SetClasses failed because incompleted initialization!");
+        return false;
+    }
+}
+
+bool TSObjectDetection::SetClassAwareNMS(const bool class_aware)
+{
+    if (nullptr != impl) {
+        return static_cast<TSObjectDetectionImpl*>(impl)->SetClassAwareNMS(class_aware);
+    } else {
+        TS_ERROR_LOG("TSObjectDetection::SetClassAwareNMS failed because incompleted initialization!");
+        return false;
+    }
+}
+
+bool TSObjectDetection::SetMotionGate(const ts::MotionGateParams& params)
+{
+    if (nullptr != impl) {
+        return static_cast<TSObjectDetectionImpl*>(impl)->SetMotionGate(params);
+    } else {
+        TS_ERROR_LOG("TSObjectDetection::SetMotionGate failed because incompleted initialization!");
+        return false;
+    }
+}
+
+bool TSObjectDetection::GetMotionStats(ts::MotionStats& stats)
+{
+    if (nullptr != impl) {
+        return static_cast<TSObjectDetectionImpl*>(impl)->GetMotionStats(stats);
+    } else {
+        TS_ERROR_LOG("TSObjectDetection::GetMotionStats failed because incompleted initialization!");
+        return false;
+    }
+}
+
+bool TSObjectDetection::SetTracker(const ts::TrackerParams& params)
+{
+    if (nullptr != impl) {
+        return static_cast<TSObjectDetectionImpl*>(impl)->SetTracker(params);
+    } else {
+        TS_ERROR_LOG("TSObjectDetection::SetTracker failed because incompleted initialization!");
+        return false;
+    }
+}
+
+bool TSObjectDetection::GetTrackerStats(ts::TrackerStats& stats)
+{
+    if (nullptr != impl) {
+        return static_cast<TSObjectDetectionImpl*>(impl)->GetTrackerStats(stats);
+    } else {
+        TS_ERROR_LOG("TSObjectDetection::GetTrackerStats failed because incompleted initialization!");
+        return false;
+    }
+}
+
+bool TSObjectDetection::SetTiling(const ts::TilingParams& params)
+{
+    if (nullptr != impl) {
+        return static_cast<TSObjectDetectionImpl*>(impl)->SetTiling(params);
+    } else {
+        TS_ERROR_LOG("TSObjectDetection::SetTiling failed because incompleted initialization!");
+        return false;
+    }
+}
+
+bool TSObjectDetection::SetFovea(const ts::FoveaParams& params)
+{
+    if (nullptr != impl) {
+        return static_cast<TSObjectDetectionImpl*>(impl)->SetFovea(params);
+    } else {
+        TS_ERROR_LOG("TSObjectDetection::SetFovea failed because incompleted initialization!");
+        return false;
+    }
+}
+
+bool TSObjectDetection::GetFoveaStats(ts::FoveaStats& stats)
+{
+    if (nullptr != impl) {
+        return static_cast<TSObjectDetectionImpl*>(impl)->GetFoveaStats(stats);
+    } else {
+        TS_ERROR_LOG("TSObjectDetection::GetFoveaStats failed because incompleted initialization!");
+        return false;
+    }
+}
+
+bool TSObjectDetection::GetNMSStats(ts::NmsStats& stats)
+{
+    if (nullptr != impl) {
+        return static_cast<TSObjectDetectionImpl*>(impl)->GetNMSStats(stats);
+    } else {
+        TS_ERROR_LOG("TSObjectDetection::GetNMSStats failed because incompleted initialization!");
+        return false;
+    }
+}
+
+void DetectionView::toObjectData(std::vector<ObjectData>& results) const
+{
+    results.reserve(results.size() + size);
+    for (size_t i = 0; i < size; i++) {
+        ObjectData rect(x[i], y[i], width[i], height[i]);
+        rect.confidence = confidence[i];
+        rect.label = label[i];
+        if (nullptr != trackId) {
+            rect.track_id = trackId[i];
+        }
+        results.push_back(rect);
+    }
+}
+
 }   // namespace ts
@@ -19,7 +19,32 @@
 
 #include "TSYolov5sImpl.h"
 
-TSObjectDetectionImpl::TSObjectDetectionImpl() : m_task(nullptr) {
+// The view of a YUV 4:2:0 frame starts on even coordinates, the corner is moved down
+// and the size grown so the region keeps its right and bottom edges.
+static ts::TSRect_T<int> alignRoi(const ts::TSImgData& image, const ts::TSRect_T<int>& roi)
+{
+    if (roi.empty() || (TYPE_NV12 != image.format() && TYPE_I420 != image.format())) {
+        return roi;
+    }
+    return ts::TSRect_T<int>(roi.x & ~1, roi.y & ~1, roi.width + (roi.x & 1), roi.height + (roi.y & 1));
+}
+
+// Longer box sides a head predicts in practice: from half the smallest to twice the
+// largest of its anchors. Smaller and larger objects go to the first and last head.
+static void headSizeRange(const int head, float& minSize, float& maxSize)
+{
+    float smallest = 0.0f;
+    maxSize = 0.0f;
+    for (int a = 0; a < 3; a++) {
+        const float side = std::max(MODEL_ANCHORS[head][2 * a], MODEL_ANCHORS[head][2 * a + 1]);
+        smallest = (0 == a) ? side : std::min(smallest, side);
+        maxSize = std::max(maxSize, side);
+    }
+    minSize = (0 == head) ? 0.0f : smallest / 2;
+    maxSize = (MODEL_HEADS - 1 == head) ? INFINITY : maxSize * 2;
+}
+
+TSObjectDetectionImpl::TSObjectDetectionImpl() {
 
 }
 
@@ -29,100 +54,262 @@ TSObjectDetectionImpl::~TSObjectDetectionImpl() {
 
 bool TSObjectDetectionImpl::Initialize(const std::string& model_path, const runtime_t runtime)
 {
-    m_task = std::move(std::unique_ptr<snpetask::SNPETask>(new snpetask::SNPETask()));
+    if (m_batchSize > 0 && !(m_inputWidth > 0 && m_inputHeight > 0)) {
+        TS_ERROR_LOG("The batch size needs the input size!");
+        return false;
+    }
 
-    m_outputLayers.push_back(OUTPUT_NODE0);        // stride: 8
-    m_outputLayers.push_back(OUTPUT_NODE1);        // stride: 16
-    m_outputLayers.push_back(OUTPUT_NODE2);        // stride: 32
-    m_outputTensors.push_back(OUTPUT_TENSOR0);     // 1*80*80*3*85
-    m_outputTensors.push_back(OUTPUT_TENSOR1);     // 1*40*40*3*85
-    m_outputTensors.push_back(OUTPUT_TENSOR2);     // 1*20*20*3*85
+    // Only the heads predicting the configured object sizes are computed and decoded.
+    m_outputLayers.clear();
+    m_outputTensors.clear();
+    m_outputHeads.clear();
+    const float maxSize = m_maxSize > 0 ? m_maxSize : INFINITY;
+    for (int i = 0; i < MODEL_HEADS; i++) {
+        float headMin, headMax;
+        headSizeRange(i, headMin, headMax);
+        if (headMax < m_minSize || headMin > maxSize) {
+            TS_INFO_LOG("Skip output head of stride %d", static_cast<int>(MODEL_STRIDES[i]));
+            continue;
+        }
+        m_outputLayers.push_back(MODEL_OUTPUT_NODES[i]);       // stride: 8/16/32
+        m_outputTensors.push_back(MODEL_OUTPUT_TENSORS[i]);    // 1*80*80*3*85, 1*40*40*3*85, 1*20*20*3*85
+        m_outputHeads.push_back(i);
+    }
 
-    m_task->setOutputLayers(m_outputLayers);
+    // Every engine of the pool is built the same way, from a single load of the model.
+    auto setup = [this] (snpetask::SNPETask& task) {
+        if (!task.setOutputLayers(m_outputLayers) ||
+            !task.setInputEncoding(INPUT_TENSOR, m_inputEncoding) ||
+            !task.setOutputEncoding(m_outputEncoding)) {
+            return false;
+        }
+        if (m_inputWidth > 0 && m_inputHeight > 0) {
+            // NHWC, the output grids follow the input and are read back from the output shapes.
+            return task.setInputDimensions(INPUT_TENSOR, {static_cast<size_t>(m_batchSize > 0 ? m_batchSize : 1),
+                static_cast<size_t>(m_inputHeight), static_cast<size_t>(m_inputWidth), 3});
+        }
+        return true;
+    };
 
-    m_task->init(model_path, runtime);
+    m_engines = std::make_shared<ts::TSEnginePool>();
+    if (!m_engines->init(model_path, runtime, m_engineCount, setup)) {
+        TS_ERROR_LOG("Failed to init SNPETask with %s", model_path.c_str());
+        m_engines.reset();
+        return false;
+    }
+    m_task = m_engines->engine(0);
+    if (m_engineCount > 1) {
+        TS_INFO_LOG("%d engines of %s", m_engineCount, model_path.c_str());
+    }
 
-    m_output = new float[MODEL_OUTPUT_GRIDS * MODEL_OUTPUT_CHANNEL];
+    return SetupInput();
+}
 
-    m_isInit = true;
-    return true;
+bool TSObjectDetectionImpl::InitializeShared(const TSObjectDetectionImpl& other)
+{
+    if (!other.m_isInit) {
+        TS_ERROR_LOG("The engines can only be shared by an initialized detector!");
+        return false;
+    }
+
+    // The engines decide the input and the output heads, the rest is this detector's own.
+    m_inputWidth = other.m_inputWidth;
+    m_inputHeight = other.m_inputHeight;
+    m_batchSize = other.m_batchSize;
+    m_inputEncoding = other.m_inputEncoding;
+    m_outputEncoding = other.m_outputEncoding;
+    m_outputLayers = other.m_outputLayers;
+    m_outputTensors = other.m_outputTensors;
+    m_outputHeads = other.m_outputHeads;
+    m_engineCount = other.m_engineCount;
+
+    m_engines = other.m_engines;
+    m_task = m_engines->engine(0);
+
+    return SetupInput();
 }
 
-bool TSObjectDetectionImpl::DeInitialize()
+bool TSObjectDetectionImpl::SetupInput()
 {
-    if (m_task) {
-        m_task->deInit();
-        m_task.reset(nullptr);
+    auto inputShape = m_task->getInputShape(INPUT_TENSOR);
+    if (inputShape.size() != 4) {
+        TS_ERROR_LOG("Unexpected rank %zu of input tensor %s", inputShape.size(), INPUT_TENSOR);
+        return false;
     }
+    m_batch = static_cast<int>(inputShape[0]);
+    TS_INFO_LOG("Input tensor %s: %zux%zu, batch %d", INPUT_TENSOR, inputShape[2], inputShape[1], m_batch);
 
-    if (m_output) {
-        delete[] m_output;
-        m_output = nullptr;
+    // The letterbox writes the input encoding directly, no float tensor in between.
+    float step = 1.0f / 255.0f;
+    int offset = 0;
+    if (ENCODING_TF8 == m_inputEncoding) {
+        m_task->getInputQuantParams(INPUT_TENSOR, step, offset);
+    }
+    m_letterboxes.clear();
+    m_letterboxes.resize(m_batch);
+    for (auto& letterbox : m_letterboxes) {
+        letterbox.setInterpolation(m_interp);
+        letterbox.setEncoding(m_inputEncoding, step, offset);
     }
+    m_slices.assign(m_batch, SliceGeometry());
+
+    TS_INFO_LOG("Using %s decode kernels", m_kernels->name);
+
+    m_isInit = true;
+    return true;
+}
+
+bool TSObjectDetectionImpl::DeInitialize()
+{
+    // The engines are released with the last detector sharing them.
+    m_task = nullptr;
+    m_engines.reset();
 
     m_isInit = false;
     return true;
 }
 
-bool TSObjectDetectionImpl::PreProcess(const ts::TSImgData& image)
+TSObjectDetectionImpl::EngineLease::EngineLease(TSObjectDetectionImpl& impl) : m_impl(impl)
+{
+    bool reused = false;
+    m_impl.m_task = m_impl.m_engines->acquire(&m_impl, reused);
+    if (!reused) {
+        // Another detector wrote into this input tensor, the cached letterbox padding is gone.
+        for (auto& letterbox : m_impl.m_letterboxes) {
+            letterbox.invalidate();
+        }
+        for (auto& letterbox : m_impl.m_mosaicLetterboxes) {
+            letterbox.invalidate();
+        }
+    }
+}
+
+TSObjectDetectionImpl::EngineLease::~EngineLease()
+{
+    m_impl.m_engines->release(m_impl.m_task);
+}
+
+void* TSObjectDetectionImpl::InputSlice(const int slice)
+{
+    auto inputShape = m_task->getInputShape(INPUT_TENSOR);
+
+    // Each batch slice is a whole NHWC image.
+    size_t offset = slice * inputShape[1] * inputShape[2] * 3;
+
+    if (ENCODING_TF8 == m_inputEncoding) {
+        uint8_t* tensor = m_task->getInputTensorTf8(INPUT_TENSOR);
+        return tensor ? tensor + offset : nullptr;
+    } else if (ENCODING_FP16 == m_inputEncoding) {
+        uint16_t* tensor = m_task->getInputTensorFp16(INPUT_TENSOR);
+        return tensor ? tensor + offset : nullptr;
+    } else {
+        float* tensor = m_task->getInputTensor(INPUT_TENSOR);
+        return tensor ? tensor + offset : nullptr;
+    }
+}
+
+bool TSObjectDetectionImpl::PreProcess(const ts::TSImgData& image, const int slice)
 {
     auto inputShape = m_task->getInputShape(INPUT_TENSOR);
 
-    size_t batch = inputShape[0];
     size_t inputHeight = inputShape[1];
     size_t inputWidth = inputShape[2];
-    size_t channel = inputShape[3];
 
-    if (m_task->getInputTensor(INPUT_TENSOR) == nullptr) {
+    void* input = InputSlice(slice);
+    if (input == nullptr) {
         TS_ERROR_LOG("Empty input tensor");
         return false;
     }
 
-    cv::Mat input(inputHeight, inputWidth, CV_32FC3, m_task->getInputTensor(INPUT_TENSOR), inputWidth * channel);
+    if (0 == slice && m_mosaicTensor) {
+        m_letterboxes[0].invalidate();
+        m_mosaicTensor = false;
+    }
 
-    if (image.empty()) {
-        TS_ERROR_LOG("Invalid image!");
+    // Channel swap, resize, padding and normalization in one pass over the frame.
+    ts::TSLetterbox& letterbox = m_letterboxes[slice];
+    if (!letterbox.run(image, input, inputWidth, inputHeight, &m_preProcessPool)) {
         return false;
     }
 
-    int imgFormat = image.format();
-    if (imgFormat != TYPE_BGR_U8 && imgFormat != TYPE_RGB_U8) {
-        TS_ERROR_LOG("Invaild image format %d, expected to be rgb or bgr!", imgFormat);
+    m_slices[slice].scale = letterbox.scale();
+    m_slices[slice].xOffset = letterbox.xOffset();
+    m_slices[slice].yOffset = letterbox.yOffset();
+
+    return true;
+}
+
+bool TSObjectDetectionImpl::Detect(const ts::TSImgData& image,
+    std::vector<ts::ObjectData>& results)
+{
+    ts::DetectionView detections;
+    if (!Detect(image, detections)) {
         return false;
     }
 
-    int imgWidth = image.width();
-    int imgHeight = image.height();
-    
-    m_scale = std::min(inputHeight /(float)imgHeight, inputWidth / (float)imgWidth);
-    int scaledWidth = imgWidth * m_scale;
-    int scaledHeight = imgHeight * m_scale;
-    m_xOffset = (inputWidth - scaledWidth) / 2;
-    m_yOffset = (inputHeight - scaledHeight) / 2;
+    detections.toObjectData(results);
+    return true;
+}
+
+bool TSObjectDetectionImpl::Detect(const std::vector<ts::TSImgData>& images,
+    std::vector<std::vector<ts::ObjectData> >& results)
+{
+    results.resize(images.size());
+    EngineLease lease(*this);
 
-    cv::Mat image_tmp(imgHeight, imgWidth, CV_8UC3, image.data(), image.stride());
-    if (imgFormat == TYPE_BGR_U8) {
-        cv::cvtColor(image_tmp, image_tmp, cv::COLOR_BGR2RGB);
-    }
+    // The stream detections stay as they are for the next single frame Detect.
+    m_detections.swap(m_batchDetections);
+    bool ret = true;
+    for (size_t first = 0; ret && first < images.size(); first += m_batch) {
+        const size_t count = std::min(static_cast<size_t>(m_batch), images.size() - first);
+        for (size_t b = 0; ret && b < count; b++) {
+            const ts::TSImgData& image = images[first + b];
+            const ts::TSRect_T<int> roi = alignRoi(image, m_roi);
+            m_slices[b].roi = roi;
+            ret = roi.empty() ? PreProcess(image, b) : PreProcess(image.roi(roi), b);
+            if (!ret) {
+                TS_ERROR_LOG("PreProcess of frame %zu failed.", first + b);
+            }
+        }
 
-    cv::Mat inputMat(inputHeight, inputWidth, CV_8UC3, cv::Scalar(128, 128, 128));
-    cv::Mat roiMat(inputMat, cv::Rect(m_xOffset, m_yOffset, scaledWidth, scaledHeight));
-    cv::resize(image_tmp, roiMat, cv::Size(scaledWidth, scaledHeight), cv::INTER_LINEAR);
+        if (ret && !m_task->execute()) {
+            TS_ERROR_LOG("SNPETask execute failed.");
+            ret = false;
+        }
 
-    inputMat.convertTo(input, CV_32FC3);
-    input /= 255.0f;
+        // Each slice is decoded with the geometry of its frame, the region masks are cached per slice.
+        for (size_t b = 0; ret && b < count; b++) {
+            m_detections.clear();
+            ret = Decode(b, b, m_decodeParams);
+            if (ret) {
+                m_nms.run(m_detections, m_nmsThresh, m_maxDetections);
+                results[first + b].clear();
+                m_detections.view().toObjectData(results[first + b]);
+            }
+        }
+    }
+    m_detections.swap(m_batchDetections);
 
+    return ret;
 }
 
-bool TSObjectDetectionImpl::Detect(const ts::TSImgData& image,
-    std::vector<ts::ObjectData>& results)
+bool TSObjectDetectionImpl::Inference(const ts::TSImgData& image, const ts::TSRect_T<int>& region)
 {
+    // The boxes are mapped back with the region actually letterboxed.
+    const ts::TSRect_T<int> roi = alignRoi(image, region);
+    m_slices[0].roi = roi;
 
-    if (m_roi.empty()) {
-        PreProcess(image);
+    bool ret;
+    if (roi.empty()) {
+        ret = PreProcess(image, 0);
     } else {
-        auto roi_image = image.roi(m_roi);
-        PreProcess(roi_image);
+        auto roi_image = image.roi(roi);
+        ret = PreProcess(roi_image, 0);
+    }
+
+    if (!ret) {
+        TS_ERROR_LOG("PreProcess failed.");
+        return false;
     }
 
     if (!m_task->execute()) {
@@ -130,108 +317,870 @@ bool TSObjectDetectionImpl::Detect(const ts::TSImgData& image,
         return false;
     }
 
-    PostProcess(results);
+    return true;
+}
+
+TSObjectDetectionImpl::MotionDecision TSObjectDetectionImpl::GateMotion(const ts::TSImgData& image,
+    ts::TSRect_T<int>& region)
+{
+    const ts::TSRect_T<int> area = m_roi.empty() ?
+        ts::TSRect_T<int>(0, 0, image.width(), image.height()) : m_roi;
+    region = area;
+
+    // The thumbnail is taken on every frame, a forced refresh makes it the reference too.
+    ts::TSRect_T<int> motion;
+    const bool moved = m_motionGate.detect(image, area, motion);
+    if (m_motionFrames >= m_motionParams.maxSkip) {
+        return MOTION_FULL;
+    }
+    if (!moved) {
+        return MOTION_SKIP;
+    }
+    // A crop would change the tile or mosaic layout, such frames are skipped or detected as a whole.
+    if (m_tilingParams.tileWidth > 0 || m_tilingParams.tileHeight > 0 || !m_mosaicRois.empty()) {
+        return MOTION_FULL;
+    }
+
+    // Padded motion, at least the model input size so the crop is never upscaled.
+    const int pad = m_motionParams.padding;
+    int x0 = motion.x - pad;
+    int y0 = motion.y - pad;
+    int x1 = motion.x + motion.width + pad;
+    int y1 = motion.y + motion.height + pad;
+    auto inputShape = m_task->getInputShape(INPUT_TENSOR);
+    auto fit = [] (int& lo, int& hi, const int minLength, const int begin, const int end) {
+        if (hi - lo < minLength) {
+            lo = (lo + hi - minLength) / 2;
+            hi = lo + minLength;
+        }
+        if (lo < begin) {
+            hi += begin - lo;
+            lo = begin;
+        }
+        if (hi > end) {
+            lo = std::max(begin, lo - (hi - end));
+            hi = end;
+        }
+    };
+    fit(x0, x1, std::min(area.width, static_cast<int>(inputShape[2])), area.x, area.x + area.width);
+    fit(y0, y1, std::min(area.height, static_cast<int>(inputShape[1])), area.y, area.y + area.height);
+
+    // Grown to cover every previous box it touches: such boxes are detected again as
+    // a whole instead of being cut by the crop. The corner stays even, the chroma
+    // planes of YUV frames are subsampled.
+    x0 &= ~1;
+    y0 &= ~1;
+    for (bool grown = true; grown; ) {
+        grown = false;
+        for (size_t i = 0; i < m_detections.size(); i++) {
+            const ts::TSRect_T<int> box = m_detections.rect(i);
+            const int bx1 = box.x + box.width;
+            const int by1 = box.y + box.height;
+            if (box.x < x1 && bx1 > x0 && box.y < y1 && by1 > y0 &&
+                (box.x < x0 || box.y < y0 || bx1 > x1 || by1 > y1)) {
+                x0 = std::min(x0, box.x & ~1);
+                y0 = std::min(y0, box.y & ~1);
+                x1 = std::max(x1, bx1);
+                y1 = std::max(y1, by1);
+                grown = true;
+            }
+        }
+    }
+    x0 = std::max(x0, area.x & ~1);
+    y0 = std::max(y0, area.y & ~1);
+    x1 = std::min(x1, area.x + area.width);
+    y1 = std::min(y1, area.y + area.height);
+
+    const ts::TSRect_T<int> crop(x0, y0, x1 - x0, y1 - y0);
+    if (static_cast<float>(crop.area()) >= m_motionParams.maxCropArea * area.area()) {
+        return MOTION_FULL;
+    }
+
+    region = crop;
+    return MOTION_CROP;
+}
+
+void TSObjectDetectionImpl::LayoutTiles(const ts::TSRect_T<int>& area)
+{
+    m_tileArea = area;
+    m_tiles.clear();
+
+    // Tiles spread evenly along one axis, neighbours overlapping by at least overlap.
+    // Starts are relative to begin, lengths are the same for every tile.
+    auto spread = [] (std::vector<int>& starts, int& length, const int size, const int tile,
+        const int overlap, int count) {
+        length = std::min(tile, size);
+        if (count <= 0) {
+            count = length >= size ? 1 : (size - overlap + tile - overlap - 1) / (tile - overlap);
+        } else if (count > 1) {
+            // Enough for the requested count to cover the size.
+            length = std::min(size, std::max(length, (size + (count - 1) * overlap + count - 1) / count));
+        }
+        starts.resize(count);
+        for (int i = 0; i < count; i++) {
+            starts[i] = count > 1 ? static_cast<int>(lroundf(static_cast<float>(i) * (size - length) / (count - 1))) : 0;
+        }
+    };
+
+    std::vector<int> xs, ys;
+    int width = 0, height = 0;
+    const int tileWidth = m_tilingParams.tileWidth > 0 ? m_tilingParams.tileWidth : m_tilingParams.tileHeight;
+    const int tileHeight = m_tilingParams.tileHeight > 0 ? m_tilingParams.tileHeight : m_tilingParams.tileWidth;
+    spread(xs, width, area.width, tileWidth, m_tilingParams.overlap, m_tilingParams.cols);
+    spread(ys, height, area.height, tileHeight, m_tilingParams.overlap, m_tilingParams.rows);
+
+    for (size_t j = 0; j < ys.size(); j++) {
+        for (size_t i = 0; i < xs.size(); i++) {
+            // The corner stays even, the chroma planes of YUV frames are subsampled.
+            Tile tile;
+            const int x = (area.x + xs[i]) & ~1;
+            const int y = (area.y + ys[j]) & ~1;
+            tile.rect = ts::TSRect_T<int>(x, y, area.x + xs[i] + width - x, area.y + ys[j] + height - y);
+            tile.left = i > 0 ? area.x + xs[i - 1] + width - x : 0;
+            tile.top = j > 0 ? area.y + ys[j - 1] + height - y : 0;
+            tile.right = i + 1 < xs.size() ? x + tile.rect.width - ((area.x + xs[i + 1]) & ~1) : 0;
+            tile.bottom = j + 1 < ys.size() ? y + tile.rect.height - ((area.y + ys[j + 1]) & ~1) : 0;
+            m_tiles.push_back(tile);
+        }
+    }
+
+    // The full frame job is useless if a single tile covers the area.
+    if (m_tilingParams.fullFrame && m_tiles.size() > 1) {
+        Tile full;
+        full.rect = area;
+        m_tiles.push_back(full);
+    }
+
+    TS_INFO_LOG("Tiling %dx%d area in %zux%zu tiles of %dx%d", area.width, area.height,
+        xs.size(), ys.size(), width, height);
+}
+
+bool TSObjectDetectionImpl::Tile::cuts(const ts::TSRect_T<int>& box) const
+{
+    // Boxes this close to a seam are cut by it.
+    const int margin = 2;
+    return (left > 0 && box.x <= rect.x + margin && box.width < left) ||
+        (top > 0 && box.y <= rect.y + margin && box.height < top) ||
+        (right > 0 && box.x + box.width >= rect.x + rect.width - margin && box.width < right) ||
+        (bottom > 0 && box.y + box.height >= rect.y + rect.height - margin && box.height < bottom);
+}
+
+bool TSObjectDetectionImpl::DetectRegions(const ts::TSImgData& image, const std::vector<Tile>& regions,
+    const size_t maskBase)
+{
+    for (size_t first = 0; first < regions.size(); first += m_batch) {
+        const size_t count = std::min(static_cast<size_t>(m_batch), regions.size() - first);
+        for (size_t b = 0; b < count; b++) {
+            const ts::TSRect_T<int>& rect = regions[first + b].rect;
+            m_slices[b].roi = rect;
+            if (!PreProcess(image.roi(rect), b)) {
+                TS_ERROR_LOG("PreProcess of region %zu failed.", first + b);
+                return false;
+            }
+        }
+
+        if (!m_task->execute()) {
+            TS_ERROR_LOG("SNPETask execute failed.");
+            return false;
+        }
+
+        // Each region is decoded in place, then the boxes cut by its seams are dropped.
+        for (size_t b = 0; b < count; b++) {
+            const size_t begin = m_detections.size();
+            if (!Decode(b, maskBase + first + b, m_decodeParams)) {
+                return false;
+            }
+
+            const Tile& region = regions[first + b];
+            size_t kept = begin;
+            for (size_t i = begin; i < m_detections.size(); i++) {
+                if (region.cuts(m_detections.rect(i))) {
+                    continue;
+                }
+                if (kept != i) {
+                    m_detections.copy(kept, m_detections, i);
+                }
+                kept++;
+            }
+            m_detections.truncate(kept);
+        }
+    }
+
+    return true;
+}
+
+bool TSObjectDetectionImpl::DetectTiles(const ts::TSImgData& image, const ts::TSRect_T<int>& area)
+{
+    if (!(area == m_tileArea)) {
+        LayoutTiles(area);
+    }
+
+    m_detections.clear();
+    if (!DetectRegions(image, m_tiles, 0)) {
+        return false;
+    }
 
+    // A single NMS over the tiles removes the duplicates of the overlaps.
+    m_nms.run(m_detections, m_nmsThresh, m_maxDetections);
     return true;
 }
 
-bool TSObjectDetectionImpl::PostProcess(std::vector<ts::ObjectData> &results)
+bool TSObjectDetectionImpl::Refine(const ts::TSImgData& image, const ts::TSRect_T<int>& area)
 {
-    float strides[3] = {8, 16, 32};
-    float anchorGrid[][6] = {
-        {10, 13, 16, 30, 33, 23},       // 8*8
-        {30, 61, 62, 45, 59, 119},      // 16*16
-        {116, 90, 156, 198, 373, 326},  // 32*32
+    m_foveaStats.frames++;
+
+    // Uncertain or small boxes of the first pass, the most likely objects first.
+    const float scale = m_slices[0].scale;
+    const float* confidence = m_detections.confidence();
+    m_foveaOrder.clear();
+    for (size_t i = 0; i < m_detections.size(); i++) {
+        const float size = std::max(m_detections.width()[i], m_detections.height()[i]) * scale;
+        if (confidence[i] < m_foveaParams.refineThresh || size < m_foveaParams.smallSize) {
+            m_foveaOrder.push_back(i);
+        }
+    }
+    std::stable_sort(m_foveaOrder.begin(), m_foveaOrder.end(), [confidence] (size_t left, size_t right) {
+        return confidence[left] > confidence[right];
+    });
+    m_foveaStats.candidates += m_foveaOrder.size();
+
+    // Crops of the model input size centred on them, so they are detected at full
+    // resolution. A candidate seen whole by an earlier crop gets no crop of its own.
+    // Their inner sides cut every box touching them, the sides on the area border none.
+    auto inputShape = m_task->getInputShape(INPUT_TENSOR);
+    const int width = std::min(area.width, static_cast<int>(inputShape[2]));
+    const int height = std::min(area.height, static_cast<int>(inputShape[1]));
+    auto sees = [] (const Tile& crop, const ts::TSRect_T<int>& box) {
+        return box.x >= crop.rect.x && box.y >= crop.rect.y &&
+            box.x + box.width <= crop.rect.x + crop.rect.width &&
+            box.y + box.height <= crop.rect.y + crop.rect.height && !crop.cuts(box);
     };
+    m_foveaCrops.clear();
+    for (size_t i : m_foveaOrder) {
+        if (m_foveaCrops.size() >= static_cast<size_t>(m_foveaParams.maxCrops)) {
+            break;
+        }
+        const ts::TSRect_T<int> box = m_detections.rect(i);
+        bool seen = false;
+        for (const auto& crop : m_foveaCrops) {
+            seen = seen || sees(crop, box);
+        }
+        if (seen) {
+            continue;
+        }
 
-    // copy all outputs to one array.
-    // [80 * 80 * 3 * 85]----\
-    // [40 * 40 * 3 * 85]--------> [25200 * 85]
-    // [20 * 20 * 3 * 85]----/
-    float* tmpOutput = m_output;
-    for (size_t i = 0; i < 3; i++) {
-        auto outputShape = m_task->getOutputShape(m_outputTensors[i]);
-        const float *predOutput = m_task->getOutputTensor(m_outputTensors[i]);
-
-        int batch = outputShape[0];
-        int height = outputShape[1];
-        int width = outputShape[2];
-        int channel = outputShape[3];
-
-        for (int j = 0; j < height; j++) {      // 80/40/20
-            for (int k = 0; k < width; k++) {   // 80/40/20
-                int anchorIdx = 0;
-                for (int l = 0; l < 3; l++) {   // 3
-                    for (int m = 0; m < channel / 3; m++) {     // 85
-                        if (m < 2) {
-                            float value = *predOutput;
-                            float gridValue = m == 0 ? k : j;
-                            *tmpOutput = (value * 2 - 0.5 + gridValue) * strides[i];
-                        } else if (m < 4) {
-                            float value = *predOutput;
-                            *tmpOutput = value * value * 4 * anchorGrid[i][anchorIdx++];
-                        } else {
-                            *tmpOutput = *predOutput;
-                        }
-                        tmpOutput++;
-                        predOutput++;
-                    }
+        // The corner stays even, the chroma planes of YUV frames are subsampled.
+        Tile crop;
+        const int x = std::max(area.x, std::min(box.x + box.width / 2 - width / 2, area.x + area.width - width));
+        const int y = std::max(area.y, std::min(box.y + box.height / 2 - height / 2, area.y + area.height - height));
+        crop.rect = ts::TSRect_T<int>(x & ~1, y & ~1, width, height);
+        crop.left = crop.rect.x > area.x ? width : 0;
+        crop.top = crop.rect.y > area.y ? height : 0;
+        crop.right = crop.rect.x + width < area.x + area.width ? width : 0;
+        crop.bottom = crop.rect.y + height < area.y + area.height ? height : 0;
+        m_foveaCrops.push_back(crop);
+    }
+    m_foveaStats.crops += m_foveaCrops.size();
+
+    // First pass boxes seen whole by a crop are replaced by its detections, the
+    // others are kept if they pass the score threshold of their label.
+    auto threshold = [this] (const int label) {
+        for (size_t c = 0; c < m_decodeParams.classes.size(); c++) {
+            if (m_decodeParams.classes[c] == label && m_decodeParams.classThresh[c] >= 0.0f) {
+                return m_decodeParams.classThresh[c];
+            }
+        }
+        return m_decodeParams.confThresh;
+    };
+    const int* label = m_detections.label();
+    size_t kept = 0;
+    for (size_t i = 0; i < m_detections.size(); i++) {
+        const ts::TSRect_T<int> box = m_detections.rect(i);
+        bool seen = false;
+        for (const auto& crop : m_foveaCrops) {
+            seen = seen || sees(crop, box);
+        }
+        if (seen || confidence[i] <= threshold(label[i])) {
+            continue;
+        }
+        if (kept != i) {
+            m_detections.copy(kept, m_detections, i);
+        }
+        kept++;
+    }
+    m_detections.truncate(kept);
+
+    // Mask slot 0 is the first pass.
+    if (!DetectRegions(image, m_foveaCrops, 1)) {
+        return false;
+    }
+
+    m_nms.run(m_detections, m_nmsThresh, m_maxDetections);
+    return true;
+}
+
+float TSObjectDetectionImpl::PackMosaic(const std::vector<ts::TSRect_T<int> >& rois, const int inputWidth,
+    const int inputHeight, const int gap, std::vector<MosaicCell>& cells)
+{
+    cells.clear();
+    if (rois.empty()) {
+        return 0.0f;
+    }
+
+    // Shelves filled left to right by decreasing region height, with a scale shared by
+    // every region so objects keep their relative sizes. Each region is scaled into a
+    // window at the corner of its cell, the rest of the cell is the gap to the next ones.
+    // The cell ending a shelf and the cells of the last shelf extend to the tensor border
+    // so the cells cover the whole tensor, the windows keep the shared scale.
+    std::vector<size_t> order(rois.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&rois] (size_t left, size_t right) {
+        return rois[left].height > rois[right].height;
+    });
+    auto pack = [&] (const float scale, std::vector<MosaicCell>& packed) {
+        packed.clear();
+        int x = 0, y = 0, shelfHeight = 0;
+        size_t shelf = 0;
+        for (size_t i : order) {
+            const int width = std::max(1, static_cast<int>(rois[i].width * scale));
+            const int height = std::max(1, static_cast<int>(rois[i].height * scale));
+            if (x > 0 && x + width + gap > inputWidth) {
+                // Close the shelf: its cells take its height, the last one the rest of the row.
+                for (size_t c = shelf; c < packed.size(); c++) {
+                    packed[c].cell.height = shelfHeight;
                 }
+                packed.back().cell.width = inputWidth - packed.back().cell.x;
+                shelf = packed.size();
+                x = 0;
+                y += shelfHeight;
+                shelfHeight = 0;
+            }
+            if (x + width + gap > inputWidth || y + height + gap > inputHeight) {
+                return false;
+            }
+            MosaicCell cell;
+            cell.roi = rois[i];
+            cell.window = ts::TSRect_T<int>(x, y, width, height);
+            cell.cell = ts::TSRect_T<int>(x, y, width + gap, height + gap);
+            packed.push_back(cell);
+            x += width + gap;
+            shelfHeight = std::max(shelfHeight, height + gap);
+        }
+        for (size_t c = shelf; c < packed.size(); c++) {
+            packed[c].cell.height = inputHeight - y;
+        }
+        packed.back().cell.width = inputWidth - packed.back().cell.x;
+        return true;
+    };
+
+    // Largest shared scale that packs, no larger than the one letterboxing the biggest region alone.
+    float high = INFINITY;
+    for (const auto& roi : rois) {
+        high = std::min(high, std::min(static_cast<float>(inputWidth - gap) / roi.width,
+            static_cast<float>(inputHeight - gap) / roi.height));
+    }
+    float low = 0.0f;
+    std::vector<MosaicCell> candidate;
+    if (pack(high, cells)) {
+        low = high;
+    } else {
+        cells.clear();
+        for (int i = 0; i < 20; i++) {
+            const float scale = (low + high) / 2;
+            if (pack(scale, candidate)) {
+                low = scale;
+                cells.swap(candidate);
+            } else {
+                high = scale;
             }
         }
     }
-    
-    std::vector<int> boxIndexs;
-    std::vector<float> boxConfidences;
-    std::vector<ts::ObjectData> winList;
+    return cells.empty() ? 0.0f : low;
+}
+
+void TSObjectDetectionImpl::LayoutMosaic(const int frameWidth, const int frameHeight)
+{
+    m_mosaicFrameWidth = frameWidth;
+    m_mosaicFrameHeight = frameHeight;
+    m_mosaicCells.clear();
 
-    for (int i = 0; i< MODEL_OUTPUT_GRIDS; i++) {
-        float boxConfidence = m_output[i * MODEL_OUTPUT_CHANNEL + 4];
-        if (boxConfidence > 0.001) {
-            boxIndexs.push_back(i);
-            boxConfidences.push_back(boxConfidence);
+    auto inputShape = m_task->getInputShape(INPUT_TENSOR);
+    const int inputWidth = static_cast<int>(inputShape[2]);
+    const int inputHeight = static_cast<int>(inputShape[1]);
+    // Gray margin between the cells, in input pixels, so objects of neighbouring cells don't merge.
+    const int gap = 8;
+
+    // The regions inside the frame, with an even corner: the chroma planes of YUV frames are subsampled.
+    std::vector<ts::TSRect_T<int> > rois;
+    for (const auto& roi : m_mosaicRois) {
+        ts::TSRect_T<int> clipped = roi & ts::TSRect_T<int>(0, 0, frameWidth, frameHeight);
+        if (clipped.empty()) {
+            TS_WARN_LOG("ROI (%d, %d, %d, %d) out of the frame", roi.x, roi.y, roi.width, roi.height);
+            continue;
         }
+        clipped.width += clipped.x & 1;
+        clipped.height += clipped.y & 1;
+        clipped.x &= ~1;
+        clipped.y &= ~1;
+        rois.push_back(clipped);
+    }
+    if (rois.empty()) {
+        return;
+    }
+
+    const float scale = PackMosaic(rois, inputWidth, inputHeight, gap, m_mosaicCells);
+    if (m_mosaicCells.empty()) {
+        TS_ERROR_LOG("Failed to pack %zu ROIs into the %dx%d input", rois.size(), inputWidth, inputHeight);
+        return;
     }
 
-    float curMaxScore = 0.0f;
-    float curMinScore = 0.0f;
+    // One letterbox per cell, with the encoding and interpolation of the others.
+    m_mosaicLetterboxes.assign(m_mosaicCells.size(), m_letterboxes[0]);
+    for (size_t i = 0; i < m_mosaicCells.size(); i++) {
+        m_mosaicLetterboxes[i].setWindow(m_mosaicCells[i].window, m_mosaicCells[i].cell);
+        m_mosaicLetterboxes[i].invalidate();
+    }
+    m_mosaicTensor = false;
+
+    TS_INFO_LOG("Mosaic of %zu ROIs at scale %f", m_mosaicCells.size(), scale);
+}
 
-    for (size_t i = 0; i < boxIndexs.size(); i++) {
-        int curIdx = boxIndexs[i];
-        float curBoxConfidence = boxConfidences[i];
+bool TSObjectDetectionImpl::DetectMosaic(const ts::TSImgData& image)
+{
+    if (m_mosaicCells.empty() || image.width() != m_mosaicFrameWidth || image.height() != m_mosaicFrameHeight) {
+        LayoutMosaic(image.width(), image.height());
+        if (m_mosaicCells.empty()) {
+            return false;
+        }
+    }
 
-        for (int j = 5; j < MODEL_OUTPUT_CHANNEL; j++) {
-            float score = curBoxConfidence * m_output[curIdx * MODEL_OUTPUT_CHANNEL + j];
-            if (score > m_confThresh) {
-                ts::ObjectData rect;
-                rect.width = m_output[curIdx * MODEL_OUTPUT_CHANNEL + 2];
-                rect.height = m_output[curIdx * MODEL_OUTPUT_CHANNEL + 3];
-                rect.x = std::max(0, static_cast<int>(m_output[curIdx * MODEL_OUTPUT_CHANNEL] - rect.width / 2)) - m_xOffset;
-                rect.y = std::max(0, static_cast<int>(m_output[curIdx * MODEL_OUTPUT_CHANNEL + 1] - rect.height / 2)) - m_yOffset;
+    auto inputShape = m_task->getInputShape(INPUT_TENSOR);
+    void* input = InputSlice(0);
+    if (input == nullptr) {
+        TS_ERROR_LOG("Empty input tensor");
+        return false;
+    }
 
-                rect.width /= m_scale;
-                rect.height /= m_scale;
-                rect.x /= m_scale;
-                rect.y /= m_scale;
-                rect.confidence = score;
-                rect.label = j - 5;
+    // The cells cover the tensor, they rewrite all of it once something else wrote there.
+    if (!m_mosaicTensor) {
+        for (auto& letterbox : m_mosaicLetterboxes) {
+            letterbox.invalidate();
+        }
+        m_letterboxes[0].invalidate();
+        m_mosaicTensor = true;
+    }
+    for (size_t i = 0; i < m_mosaicCells.size(); i++) {
+        if (!m_mosaicLetterboxes[i].run(image.roi(m_mosaicCells[i].roi), input,
+            inputShape[2], inputShape[1], &m_preProcessPool)) {
+            TS_ERROR_LOG("PreProcess of ROI %zu failed.", i);
+            return false;
+        }
+    }
 
-                winList.push_back(rect);
+    if (!m_task->execute()) {
+        TS_ERROR_LOG("SNPETask execute failed.");
+        return false;
+    }
+
+    // Decoded in input coordinates, the polygon masks don't apply to the mosaic.
+    m_slices[0] = SliceGeometry();
+    m_detections.clear();
+    if (!Decode(0, NO_MASK, m_decodeParams)) {
+        return false;
+    }
+
+    // Each box belongs to the cell of its centre. Boxes crossing the region borders of
+    // their cell span several regions, they are dropped, the others go back to the frame.
+    const int margin = 2;
+    size_t kept = 0;
+    for (size_t i = 0; i < m_detections.size(); i++) {
+        const ts::TSRect_T<int> box = m_detections.rect(i);
+        const int cx = box.x + box.width / 2;
+        const int cy = box.y + box.height / 2;
+        size_t c = 0;
+        while (c < m_mosaicCells.size() && !(cx >= m_mosaicCells[c].cell.x && cy >= m_mosaicCells[c].cell.y &&
+            cx < m_mosaicCells[c].cell.x + m_mosaicCells[c].cell.width &&
+            cy < m_mosaicCells[c].cell.y + m_mosaicCells[c].cell.height)) {
+            c++;
+        }
+        if (c == m_mosaicCells.size()) {
+            continue;
+        }
+
+        const ts::TSLetterbox& letterbox = m_mosaicLetterboxes[c];
+        const int x0 = letterbox.xOffset();
+        const int y0 = letterbox.yOffset();
+        const int x1 = x0 + letterbox.scaledWidth();
+        const int y1 = y0 + letterbox.scaledHeight();
+        if (box.x < x0 - margin || box.y < y0 - margin ||
+            box.x + box.width > x1 + margin || box.y + box.height > y1 + margin) {
+            continue;
+        }
+
+        const int left = std::max(box.x, x0);
+        const int top = std::max(box.y, y0);
+        const int right = std::min(box.x + box.width, x1);
+        const int bottom = std::min(box.y + box.height, y1);
+        const float scale = letterbox.scale();
+        const ts::TSRect_T<int>& roi = m_mosaicCells[c].roi;
+        m_detections.set(kept++, static_cast<int>((left - x0) / scale) + roi.x,
+            static_cast<int>((top - y0) / scale) + roi.y, static_cast<int>((right - left) / scale),
+            static_cast<int>((bottom - top) / scale), m_detections.confidence()[i], m_detections.label()[i]);
+    }
+    m_detections.truncate(kept);
+
+    m_nms.run(m_detections, m_nmsThresh, m_maxDetections);
+    return true;
+}
+
+bool TSObjectDetectionImpl::DetectFrame(const ts::TSImgData& image)
+{
+    MotionDecision decision = MOTION_FULL;
+    ts::TSRect_T<int> region = m_roi;
+    if (m_motionParams.maxSkip > 0) {
+        m_motionStats.frames++;
+        decision = GateMotion(image, region);
+        if (MOTION_SKIP == decision) {
+            m_motionStats.skipped++;
+            m_motionFrames++;
+            return true;
+        }
+    }
+
+    EngineLease lease(*this);
+
+    // The previous boxes outside the crop stay, the ones it touches are inside it.
+    if (MOTION_CROP == decision) {
+        m_motionKept.clear();
+        for (size_t i = 0; i < m_detections.size(); i++) {
+            if ((m_detections.rect(i) & region).empty()) {
+                m_motionKept.push_back(m_detections.x()[i], m_detections.y()[i], m_detections.width()[i],
+                    m_detections.height()[i], m_detections.confidence()[i], m_detections.label()[i]);
             }
         }
     }
 
-    winList = nms(winList, m_nmsThresh);
+    if (!m_mosaicRois.empty()) {
+        if (!DetectMosaic(image)) {
+            m_motionGate.reset();
+            return false;
+        }
+    } else if (m_tilingParams.tileWidth > 0 || m_tilingParams.tileHeight > 0) {
+        const ts::TSRect_T<int> area = region.empty() ?
+            ts::TSRect_T<int>(0, 0, image.width(), image.height()) : region;
+        if (!DetectTiles(image, area)) {
+            m_motionGate.reset();
+            return false;
+        }
+    } else {
+        if (!Inference(image, region)) {
+            m_motionGate.reset();
+            return false;
+        }
+
+        if (!PostProcess()) {
+            TS_ERROR_LOG("PostProcess failed.");
+            m_motionGate.reset();
+            return false;
+        }
+
+        if (m_foveaParams.maxCrops > 0) {
+            const ts::TSRect_T<int> area = region.empty() ?
+                ts::TSRect_T<int>(0, 0, image.width(), image.height()) : region;
+            if (!Refine(image, area)) {
+                TS_ERROR_LOG("Refine failed.");
+                m_motionGate.reset();
+                return false;
+            }
+        }
+    }
 
-    for (size_t i = 0; i < winList.size(); i++) {
-        if (winList[i].width >= m_minBoxBorder || winList[i].height >= m_minBoxBorder) {
-            if (!m_roi.empty()) {
-                winList[i].x += m_roi.x;
-                winList[i].y += m_roi.y;
+    if (m_motionParams.maxSkip > 0) {
+        if (MOTION_CROP == decision) {
+            for (size_t i = 0; i < m_motionKept.size(); i++) {
+                m_detections.push_back(m_motionKept.x()[i], m_motionKept.y()[i], m_motionKept.width()[i],
+                    m_motionKept.height()[i], m_motionKept.confidence()[i], m_motionKept.label()[i]);
             }
-            results.push_back(winList[i]);
+            m_motionStats.cropped++;
+            m_motionFrames++;
+        } else {
+            m_motionStats.full++;
+            m_motionFrames = 0;
+        }
+        m_motionGate.accept(region);
+    }
+
+    return true;
+}
+
+bool TSObjectDetectionImpl::Detect(const ts::TSImgData& image, ts::DetectionView& detections)
+{
+    if (m_trackerParams.detectInterval <= 0) {
+        if (!DetectFrame(image)) {
+            return false;
         }
+        detections = m_detections.view();
+        return true;
+    }
+
+    // Keyframes every detectInterval frames, or earlier once a track got too old,
+    // the tracks are only propagated on the other frames.
+    m_tracker.predict();
+    m_framesSinceKeyframe++;
+    if (m_framesSinceKeyframe >= m_trackerParams.detectInterval ||
+        m_tracker.minConfidence() < m_trackerParams.minConfidence) {
+        if (!DetectFrame(image)) {
+            return false;
+        }
+        m_tracker.update(m_detections);
+        m_framesSinceKeyframe = 0;
+        m_trackerStats.keyframes++;
+    }
+    m_trackerStats.frames++;
+
+    m_tracker.output(m_tracked, m_trackIds);
+    detections = m_tracked.view();
+    detections.trackId = m_trackIds.data();
+    return true;
+}
+
+bool TSObjectDetectionImpl::Count(const ts::TSImgData& image, std::vector<int>& counts,
+    ts::DensityMap* density)
+{
+    EngineLease lease(*this);
+    if (!Inference(image, m_roi) || !GetHeads(0, 0)) {
+        return false;
+    }
+
+    // Each band only writes its own rows of the score map of its head.
+    m_scoreMaps.resize(m_heads.size());
+    int cells = 0;
+    for (size_t i = 0; i < m_heads.size(); i++) {
+        ts::YoloScoreMap& map = m_scoreMaps[i];
+        map.height = m_heads[i].height;
+        map.width = m_heads[i].width;
+        map.stride = m_heads[i].stride;
+        map.score.resize(map.height * map.width);
+        map.label.resize(map.height * map.width);
+        cells += map.height * map.width;
+    }
+
+    const int threads = m_postProcessPool.size();
+    ts::splitYoloHeads(m_heads, (cells + threads - 1) / threads, m_bands);
+    m_postProcessPool.parallelFor(m_bands.size(), [this] (int band) {
+        // Every head has its own stride, it tells which map the band belongs to.
+        size_t head = 0;
+        while (m_heads[head].stride != m_bands[band].stride) {
+            head++;
+        }
+        ts::scoreYoloHead(*m_kernels, m_bands[band], m_decodeParams, m_scoreMaps[head]);
+    });
+
+    ts::findYoloPeaks(m_scoreMaps, m_classAware, m_peaks);
+
+    counts.assign(MODEL_OUTPUT_CHANNEL - 5, 0);
+    for (const auto& peak : m_peaks) {
+        counts[peak.label]++;
+    }
+
+    if (nullptr == density) {
+        return true;
+    }
+
+    // Max pool every map into the grid of the coarsest one.
+    size_t coarsest = 0;
+    for (size_t i = 1; i < m_scoreMaps.size(); i++) {
+        if (m_scoreMaps[i].stride > m_scoreMaps[coarsest].stride) {
+            coarsest = i;
+        }
+    }
+    const float stride = m_scoreMaps[coarsest].stride;
+    density->rows = m_scoreMaps[coarsest].height;
+    density->cols = m_scoreMaps[coarsest].width;
+    density->value.assign(density->rows * density->cols, 0.0f);
+    for (const auto& map : m_scoreMaps) {
+        const int ratio = static_cast<int>(stride / map.stride);
+        for (int j = 0; j < map.height; j++) {
+            float* row = density->value.data() + std::min(j / ratio, density->rows - 1) * density->cols;
+            for (int k = 0; k < map.width; k++) {
+                float& value = row[std::min(k / ratio, density->cols - 1)];
+                value = std::max(value, map.score[j * map.width + k]);
+            }
+        }
+    }
+
+    // Same mapping as the boxes of Detect: undo the letterbox, then move to full image coordinates.
+    const SliceGeometry& geometry = m_slices[0];
+    density->cellWidth = stride / geometry.scale;
+    density->cellHeight = stride / geometry.scale;
+    density->x = -geometry.xOffset / geometry.scale + geometry.roi.x;
+    density->y = -geometry.yOffset / geometry.scale + geometry.roi.y;
+
+    return true;
+}
+
+bool TSObjectDetectionImpl::GetHeads(const int slice, const size_t maskSlot)
+{
+    m_heads.clear();
+    for (size_t i = 0; i < m_outputTensors.size(); i++) {
+        auto outputShape = m_task->getOutputShape(m_outputTensors[i]);
+
+        // Batch slices follow each other, the quantization is shared.
+        const size_t offset = slice * outputShape[1] * outputShape[2] * outputShape[3];
+
+        ts::YoloHead head;
+        if (ENCODING_TF8 == m_outputEncoding) {
+            head.qdata = m_task->getOutputTensorTf8(m_outputTensors[i]);
+            if (!m_task->getOutputQuantParams(m_outputTensors[i], head.qstep, head.qoffset)) {
+                return false;
+            }
+            head.qdata = head.qdata ? head.qdata + offset : nullptr;
+        } else {
+            head.data = m_task->getOutputTensor(m_outputTensors[i]);
+            head.data = head.data ? head.data + offset : nullptr;
+        }
+        if (nullptr == head.data && nullptr == head.qdata) {
+            TS_ERROR_LOG("Empty output tensor %s.", m_outputTensors[i].c_str());
+            return false;
+        }
+        head.height = outputShape[1];   // input height / stride, 80/40/20 for 640x640
+        head.width = outputShape[2];    // input width / stride, 80/40/20 for 640x640
+        head.anchors = outputShape[3] / MODEL_OUTPUT_CHANNEL;   // 3
+        head.channels = MODEL_OUTPUT_CHANNEL;
+        head.stride = MODEL_STRIDES[m_outputHeads[i]];
+        head.anchorGrid = MODEL_ANCHORS[m_outputHeads[i]];
+
+        m_heads.push_back(head);
+    }
+
+    // Masked cells are skipped by the decode, the masks follow the letterbox geometry.
+    if (NO_MASK == maskSlot) {
+        return true;
+    }
+    if (m_regionMasks.size() <= maskSlot) {
+        m_regionMasks.resize(maskSlot + 1);
+        for (auto& mask : m_regionMasks) {
+            mask.setPolygons(m_includeRegions, m_excludeRegions);
+        }
+    }
+    ts::TSRegionMask& regionMask = m_regionMasks[maskSlot];
+    if (regionMask.enabled()) {
+        std::vector<int> heights, widths;
+        std::vector<float> strides;
+        for (const auto& head : m_heads) {
+            heights.push_back(head.height);
+            widths.push_back(head.width);
+            strides.push_back(head.stride);
+        }
+        const SliceGeometry& geometry = m_slices[slice];
+        if (regionMask.update(geometry.roi, geometry.scale, geometry.xOffset, geometry.yOffset,
+            heights, widths, strides)) {
+            // The geometry follows the motion and fovea crops, only new polygons or grids are logged.
+            std::vector<int> grids(heights);
+            grids.insert(grids.end(), widths.begin(), widths.end());
+            if (m_regionMaskGrids.size() <= maskSlot) {
+                m_regionMaskGrids.resize(maskSlot + 1);
+            }
+            if (m_regionMaskGrids[maskSlot] != grids) {
+                m_regionMaskGrids[maskSlot] = grids;
+                for (size_t i = 0; i < m_heads.size(); i++) {
+                    TS_INFO_LOG("Region mask %zu of stride %d: %zu of %d cells decoded", maskSlot,
+                        static_cast<int>(m_heads[i].stride), regionMask.activeCells(i),
+                        m_heads[i].height * m_heads[i].width);
+                }
+            }
+        }
+        for (size_t i = 0; i < m_heads.size(); i++) {
+            m_heads[i].cellMask = regionMask.mask(i);
+        }
+    }
+
+    return true;
+}
+
+bool TSObjectDetectionImpl::Decode(const int slice, const size_t maskSlot,
+    const ts::YoloDecodeParams& params)
+{
+    if (!GetHeads(slice, maskSlot)) {
+        return false;
+    }
+
+    int cells = 0;
+    for (const auto& head : m_heads) {
+        cells += head.height * head.width;
+    }
+
+    // The 80x80 head holds most of the cells, so the heads are cut into bands of
+    // about the same size and decoded in parallel, each band into its own buffer.
+    // Merging the buffers in band order gives the same candidates as a serial decode.
+    const int threads = m_postProcessPool.size();
+    ts::splitYoloHeads(m_heads, (cells + threads - 1) / threads, m_bands);
+    if (m_bandCandidates.size() < m_bands.size()) {
+        m_bandCandidates.resize(m_bands.size());
+    }
+
+    m_postProcessPool.parallelFor(m_bands.size(), [this, &params] (int band) {
+        m_bandCandidates[band].clear();
+        ts::decodeYoloHead(*m_kernels, m_bands[band], params, m_bandCandidates[band]);
+    });
+
+    // Boxes out of the size range are dropped while merging, so they neither take
+    // top_k slots nor suppress anything in NMS.
+    const float maxSize = m_maxSize > 0 ? m_maxSize : INFINITY;
+    m_candidates.clear();
+    for (size_t i = 0; i < m_bands.size(); i++) {
+        for (const auto& candidate : m_bandCandidates[i]) {
+            const float size = std::max(candidate.w, candidate.h);
+            if (size >= m_minSize && size <= maxSize) {
+                m_candidates.push_back(candidate);
+            }
+        }
+    }
+
+    ts::keepTopCandidates(m_candidates, m_topK);
+
+    // Appended in full image coordinates, NMS is left to the caller.
+    const SliceGeometry& geometry = m_slices[slice];
+    m_detections.reserve(m_detections.size() + m_candidates.size());
+    for (const auto& candidate : m_candidates) {
+        int width = candidate.w;
+        int height = candidate.h;
+        int x = std::max(0, static_cast<int>(candidate.cx - width / 2)) - geometry.xOffset;
+        int y = std::max(0, static_cast<int>(candidate.cy - height / 2)) - geometry.yOffset;
+
+        width /= geometry.scale;
+        height /= geometry.scale;
+        x /= geometry.scale;
+        y /= geometry.scale;
+
+        m_detections.push_back(x + geometry.roi.x, y + geometry.roi.y, width, height,
+            candidate.score, candidate.label);
+    }
+
+    return true;
+}
+
+bool TSObjectDetectionImpl::PostProcess()
+{
+    // The second pass needs the uncertain boxes, the first one keeps them down to the
+    // candidate threshold.
+    const ts::YoloDecodeParams* params = &m_decodeParams;
+    if (m_foveaParams.maxCrops > 0) {
+        m_candidateParams = m_decodeParams;
+        m_candidateParams.confThresh = std::min(m_candidateParams.confThresh, m_foveaParams.candidateThresh);
+        for (auto& thresh : m_candidateParams.classThresh) {
+            thresh = thresh < 0.0f ? thresh : std::min(thresh, m_foveaParams.candidateThresh);
+        }
+        params = &m_candidateParams;
+    }
+
+    m_detections.clear();
+    if (!Decode(0, 0, *params)) {
+        return false;
     }
 
+    m_nms.run(m_detections, m_nmsThresh, m_maxDetections);
     return true;
 }
@@ -12,12 +12,17 @@
 #include <sys/stat.h>
 #include <iostream>
 #include <fstream>
+#include <cmath>
+#include <cstring>
+#include <random>
 
 #include <opencv2/opencv.hpp>
 #include <gflags/gflags.h>
 
 #include "TSYolov5s.h"
 #include "TSYolov5sImpl.h"
+#include "TSMotionGate.h"
+#include "TSEnginePool.h"
 #include "TSStruct.h"
 
 static bool validateInput(const char* name, const std::string& value) 
@@ -80,6 +85,16 @@ DEFINE_validator(model_path, &validateModelPath);
 DEFINE_string(device, "CPU", "DLC runtime device.");
 DEFINE_double(confidence, 0.5, "Confidence Threshold.");
 DEFINE_double(nms, 0.5, "NMS Threshold.");
+DEFINE_string(decode_check, "", "Directory of recorded output tensors (output.raw, 329.raw, 331.raw "
+    "as written by snpe-net-run), check all decode kernels give the same boxes on them and exit.");
+DEFINE_int32(input_width, 640, "Input width of the model which recorded the decode_check tensors.");
+DEFINE_int32(input_height, 640, "Input height of the model which recorded the decode_check tensors.");
+DEFINE_bool(motion_check, false, "Check the vector and scalar motion gate comparisons agree on every "
+    "threshold and exit.");
+DEFINE_bool(mosaic_check, false, "Check the ROI mosaic keeps its regions apart at one shared scale "
+    "and exit.");
+DEFINE_bool(engine_check, false, "Check an engine pool of model_path is released when one of its "
+    "engines fails to build and exit.");
 
 static runtime_t device2runtime(std::string & device)
 {
@@ -99,10 +114,238 @@ static runtime_t device2runtime(std::string & device)
     }
 }
 
+static bool readTensor(const std::string& path, std::vector<float>& data)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) {
+        TS_ERROR_LOG("Can't open tensor file: %s", path.c_str());
+        return false;
+    }
+
+    data.resize(static_cast<size_t>(file.tellg()) / sizeof(float));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(data.data()), data.size() * sizeof(float));
+    return true;
+}
+
+// Decode the recorded heads with every kernel variant, the scalar one is the reference.
+static int checkDecodeKernels(const std::string& dir)
+{
+    const char* names[3] = {OUTPUT_TENSOR0, OUTPUT_TENSOR1, OUTPUT_TENSOR2};
+    std::vector<float> tensors[3];
+    ts::YoloHead heads[3];
+
+    for (int i = 0; i < 3; i++) {
+        if (!readTensor(dir + "/" + names[i] + ".raw", tensors[i])) {
+            return 1;
+        }
+
+        const int stride = static_cast<int>(MODEL_STRIDES[i]);
+        const int width = FLAGS_input_width / stride;
+        const int height = FLAGS_input_height / stride;
+        const size_t expected = static_cast<size_t>(width) * height * 3 * MODEL_OUTPUT_CHANNEL;
+        if (width < 1 || height < 1 || expected != tensors[i].size()) {
+            TS_ERROR_LOG("Unexpected size of tensor %s: %zu floats for a %dx%d input",
+                names[i], tensors[i].size(), FLAGS_input_width, FLAGS_input_height);
+            return 1;
+        }
+
+        heads[i].data = tensors[i].data();
+        heads[i].height = height;
+        heads[i].width = width;
+        heads[i].anchors = 3;
+        heads[i].channels = MODEL_OUTPUT_CHANNEL;
+        heads[i].stride = MODEL_STRIDES[i];
+        heads[i].anchorGrid = MODEL_ANCHORS[i];
+    }
+
+    ts::YoloDecodeParams params;
+    params.confThresh = FLAGS_confidence;
+
+    bool identical = true;
+    std::vector<ts::YoloCandidate> reference;
+    for (const ts::YoloKernels* kernels : ts::yoloKernelsAvailable()) {
+        std::vector<ts::YoloCandidate> candidates;
+        for (int i = 0; i < 3; i++) {
+            ts::decodeYoloHead(*kernels, heads[i], params, candidates);
+        }
+
+        if (reference.empty()) {
+            reference = candidates;
+        }
+
+        bool same = candidates.size() == reference.size() && 0 == memcmp(candidates.data(),
+            reference.data(), candidates.size() * sizeof(ts::YoloCandidate));
+        TS_INFO_LOG("%s kernels: %zu boxes, %s", kernels->name, candidates.size(),
+            same ? "identical" : "MISMATCH");
+        identical = identical && same;
+    }
+
+    return identical ? 0 : 1;
+}
+
+// Flat frames of the same size have thumbnails of one value, the gate must see motion
+// exactly when the two values are more than the threshold apart.
+static int checkMotionGate()
+{
+    // Thumbnail rows of 16 pixels are compared as one vector, rows of 15 by the scalar tail.
+    const int widths[2] = {16, 15};
+    const int values[][2] = {{0, 0}, {0, 255}, {255, 0}, {10, 20}, {100, 99}, {1, 255}};
+    int mismatches = 0;
+
+    for (const int width : widths) {
+        const ts::TSRect_T<int> area(0, 0, width, width);
+        for (const auto& pair : values) {
+            std::vector<uint8_t> ref(width * width, pair[0]);
+            std::vector<uint8_t> cur(width * width, pair[1]);
+            ts::TSImgData refImage(width, width, TYPE_C1_U8, ref.data(), width);
+            ts::TSImgData curImage(width, width, TYPE_C1_U8, cur.data(), width);
+
+            for (int thresh = 0; thresh <= 255; thresh++) {
+                ts::TSMotionGate gate;
+                gate.setThresholds(thresh, 0.001f);
+                ts::TSRect_T<int> motion;
+                gate.detect(refImage, area, motion);
+                gate.accept(area);
+
+                const bool expected = std::abs(pair[1] - pair[0]) > thresh;
+                if (gate.detect(curImage, area, motion) != expected) {
+                    TS_ERROR_LOG("Width %d, %d to %d, threshold %d: motion %s", width, pair[0],
+                        pair[1], thresh, expected ? "missed" : "seen");
+                    mismatches++;
+                }
+            }
+        }
+    }
+
+    TS_INFO_LOG("Motion gate: %d mismatches", mismatches);
+    return mismatches ? 1 : 0;
+}
+
+// Random region sets packed into a few input sizes: every window must be its region at
+// the shared scale, inside its cell and at least the gap away from the other windows,
+// and the cells must cover the input exactly once.
+static int checkMosaic()
+{
+    const int gap = 8;
+    const int inputs[3][2] = {{640, 640}, {960, 544}, {320, 640}};
+    std::mt19937 rng(7);
+    int errors = 0;
+
+    for (int trial = 0; trial < 300; trial++) {
+        const int inputWidth = inputs[trial % 3][0];
+        const int inputHeight = inputs[trial % 3][1];
+        std::vector<ts::TSRect_T<int> > rois(1 + rng() % 8);
+        for (auto& roi : rois) {
+            roi = ts::TSRect_T<int>(rng() % 1000 * 2, rng() % 500 * 2, 16 + rng() % 1200, 16 + rng() % 700);
+        }
+
+        std::vector<TSObjectDetectionImpl::MosaicCell> cells;
+        const float scale = TSObjectDetectionImpl::PackMosaic(rois, inputWidth, inputHeight, gap, cells);
+        if (scale <= 0.0f || cells.size() != rois.size()) {
+            TS_ERROR_LOG("Trial %d: %zu ROIs not packed", trial, rois.size());
+            errors++;
+            continue;
+        }
+
+        long long area = 0;
+        for (size_t i = 0; i < cells.size(); i++) {
+            const ts::TSRect_T<int>& window = cells[i].window;
+            const ts::TSRect_T<int>& cell = cells[i].cell;
+            area += static_cast<long long>(cell.width) * cell.height;
+            if (window.width != std::max(1, static_cast<int>(cells[i].roi.width * scale)) ||
+                window.height != std::max(1, static_cast<int>(cells[i].roi.height * scale)) ||
+                !((window & cell) == window) || cell.x < 0 || cell.y < 0 ||
+                cell.x + cell.width > inputWidth || cell.y + cell.height > inputHeight) {
+                TS_ERROR_LOG("Trial %d: window %zu not at scale %f inside its cell", trial, i, scale);
+                errors++;
+            }
+            for (size_t j = 0; j < i; j++) {
+                const ts::TSRect_T<int>& other = cells[j].window;
+                const bool apart = window.x + window.width + gap <= other.x ||
+                    other.x + other.width + gap <= window.x || window.y + window.height + gap <= other.y ||
+                    other.y + other.height + gap <= window.y;
+                if (!apart) {
+                    TS_ERROR_LOG("Trial %d: windows %zu and %zu closer than %d pixels", trial, j, i, gap);
+                    errors++;
+                }
+                if (!(cells[j].cell & cell).empty()) {
+                    TS_ERROR_LOG("Trial %d: cells %zu and %zu overlap", trial, j, i);
+                    errors++;
+                }
+            }
+        }
+        if (area != static_cast<long long>(inputWidth) * inputHeight) {
+            TS_ERROR_LOG("Trial %d: the cells don't cover the %dx%d input", trial, inputWidth, inputHeight);
+            errors++;
+        }
+    }
+
+    TS_INFO_LOG("Mosaic: %d errors", errors);
+    return errors ? 1 : 0;
+}
+
+// Pools of 3 engines whose second one fails, then none: the first pool must be left
+// empty and be destroyed cleanly, the second one must hold every engine.
+static int checkEnginePool()
+{
+    const int count = 3;
+    const int failing[2] = {1, -1};
+    int errors = 0;
+
+    for (const int k : failing) {
+        int built = 0;
+        auto setup = [&built, k] (snpetask::SNPETask& task) {
+            return built++ != k;
+        };
+
+        bool ok = false;
+        int size = 0;
+        {
+            ts::TSEnginePool pool;
+            ok = pool.init(FLAGS_model_path, device2runtime(FLAGS_device), count, setup);
+            size = pool.size();
+        }
+
+        const bool expected = k < 0;
+        if (ok != expected || size != (expected ? count : 0)) {
+            TS_ERROR_LOG("Engine %d failing: init %s with %d engines", k, ok ? "passed" : "failed", size);
+            errors++;
+        }
+    }
+
+    TS_INFO_LOG("Engine pool: %d errors", errors);
+    return errors ? 1 : 0;
+}
+
 int main(int argc, char* argv[])
 {
     google::ParseCommandLineFlags(&argc, &argv, true);
 
+    if (!FLAGS_decode_check.empty()) {
+        int ret = checkDecodeKernels(FLAGS_decode_check);
+        google::ShutDownCommandLineFlags();
+        return ret;
+    }
+
+    if (FLAGS_motion_check) {
+        int ret = checkMotionGate();
+        google::ShutDownCommandLineFlags();
+        return ret;
+    }
+
+    if (FLAGS_mosaic_check) {
+        int ret = checkMosaic();
+        google::ShutDownCommandLineFlags();
+        return ret;
+    }
+
+    if (FLAGS_engine_check) {
+        int ret = checkEnginePool();
+        google::ShutDownCommandLineFlags();
+        return ret;
+    }
+
     std::vector<std::string> labels;
     std::ifstream in(FLAGS_labels);
     std::string line;
@@ -131,6 +374,11 @@ int main(int argc, char* argv[])
 
         TS_INFO_LOG("result size: %ld", vec_res.size());
 
+        ts::NmsStats nms_stats;
+        vec_alg[i]->GetNMSStats(nms_stats);
+        TS_INFO_LOG("nms: %ld candidates, %ld kept, %ld IoU computed",
+            nms_stats.candidates, nms_stats.kept, nms_stats.comparisons);
+
         for (size_t j = 0; j < vec_res.size(); j++) {
             ts::ObjectData rect = vec_res[j];
             TS_INFO_LOG("[%d, %d, %d, %d, %f, %d]", rect.x, rect.y, rect.width, rect.height, rect.confidence, rect.label);
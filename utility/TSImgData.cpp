@@ -19,6 +19,19 @@ ts::TSImgData::TSImgData(
     impl = new ImgBuf(width, height, format, data, stride);
 }
 
+ts::TSImgData::TSImgData(
+        int32_t        width,
+        int32_t        height,
+        int32_t        format,
+        uint8_t* const planes[3],
+        const int32_t  strides[3]) {
+    ImgBuf* buf = new ImgBuf(width, height, format, planes[0], strides[0]);
+    if (ImgBuf::is_yuv420(format)) {
+        buf->set_planes(planes[1], TYPE_I420 == format ? planes[2] : nullptr, strides[1]);
+    }
+    impl = buf;
+}
+
 ts::TSImgData::TSImgData(const TSImgData& img) {
     delete reinterpret_cast<ImgBuf*>(impl);
     impl = new ImgBuf(*(reinterpret_cast<ImgBuf*>(img.impl)));
@@ -27,6 +40,24 @@ ts::TSImgData::TSImgData(const TSImgData& img) {
 ts::TSImgData ts::TSImgData::roi(TSRect_T<int> reg) const {
     assert(reg.x >= 0 && reg.y >= 0 && reg.x + reg.width <= this->width() && reg.y + reg.height <= this->height());
     ImgBuf* src_buf = reinterpret_cast<ImgBuf*>(this->impl);
+    if (ImgBuf::is_yuv420(src_buf->format())) {
+        // Chroma is subsampled by 2, the view must start on the 2x2 grid.
+        assert(0 == (reg.x & 1) && 0 == (reg.y & 1));
+        int cstride = src_buf->plane_stride(1);
+        int cx = TYPE_NV12 == src_buf->format() ? reg.x : reg.x / 2;
+        uint8_t* y = reinterpret_cast<uint8_t*>(src_buf->data()) + reg.y * src_buf->stride() + reg.x;
+        uint8_t* p1 = reinterpret_cast<uint8_t*>(src_buf->plane(1)) + reg.y / 2 * cstride + cx;
+        uint8_t* p2 = nullptr;
+        if (nullptr != src_buf->plane(2)) {
+            p2 = reinterpret_cast<uint8_t*>(src_buf->plane(2)) + reg.y / 2 * cstride + cx;
+        }
+        ts::TSImgData dst;
+        delete reinterpret_cast<ImgBuf*>(dst.impl);
+        ImgBuf* dst_buf = new ImgBuf({reg.width, reg.height}, src_buf->format(), y, src_buf->stride());
+        dst_buf->set_planes(p1, p2, cstride);
+        dst.impl = dst_buf;
+        return dst;
+    }
     uint8_t* data = reinterpret_cast<uint8_t*>(src_buf->data()) + reg.y * (src_buf->stride())
             + reg.x * (src_buf->channel()) * (src_buf->pixel_len());
     ts::TSImgData dst;
@@ -63,6 +94,14 @@ int32_t ts::TSImgData::stride() const {
     return reinterpret_cast<ImgBuf*>(impl)->stride();
 }
 
+uint8_t* ts::TSImgData::plane(int32_t index) const {
+    return reinterpret_cast<uint8_t*>(reinterpret_cast<ImgBuf*>(impl)->plane(index));
+}
+
+int32_t ts::TSImgData::planeStride(int32_t index) const {
+    return reinterpret_cast<ImgBuf*>(impl)->plane_stride(index);
+}
+
 int32_t ts::TSImgData::channels() const {
     return reinterpret_cast<ImgBuf*>(impl)->channel();
 }
@@ -44,6 +44,10 @@ constexpr int TYPE_RGB_F32                    = 0x03;
 constexpr int TYPE_C1_U8                      = 0x04;
 constexpr int TYPE_C1_F32                     = 0x05;
 constexpr int TYPE_UNKNOWN                    = 0x06;
+constexpr int TYPE_BGRX_U8                    = 0x07;
+constexpr int TYPE_RGBX_U8                    = 0x08;
+constexpr int TYPE_NV12                       = 0x09;    // Y plane + interleaved UV plane
+constexpr int TYPE_I420                       = 0x0A;    // Y plane + U plane + V plane
 
 // Inference hardware runtime.
 typedef enum runtime {
@@ -54,6 +58,20 @@ typedef enum runtime {
     AIP
 }runtime_t;
 
+// Element encoding of the model input/output buffers.
+typedef enum encoding {
+    ENCODING_FLOAT = 0,     // float32
+    ENCODING_TF8,           // uint8, real = (q - stepExactly0) * stepSize
+    ENCODING_FP16           // IEEE half float, stored as uint16
+}encoding_t;
+
+// Interpolation used when letterboxing a frame into the network input.
+typedef enum interp {
+    INTERP_NEAREST = 0,
+    INTERP_LINEAR,
+    INTERP_AREA
+}interp_t;
+
 template <typename Dtype>
 struct DPair {
     Dtype x; Dtype y;
@@ -150,6 +168,10 @@ struct TSRect_T {
             return TSRect_T<T>();
         }
     }
+    // Same corner and size. operator!= below is kept as it was: true when the corners match.
+    bool operator==(const TSRect_T<T> &t) const {
+        return x == t.x && y == t.y && width == t.width && height == t.height;
+    }
     bool operator!=(const TSRect_T<T> &t) const {
         if (std::fabs(this->x - t.x) + std::fabs(this->y - t.y) < 0.00001) {
             return true;
@@ -199,6 +221,17 @@ public:
     EXPORT_API TSImgData(int32_t width, int32_t height,
             int32_t type = TYPE_BGR_U8, uint8_t* data = nullptr, int32_t stride = -1);
 
+    /**
+     *  @brief Package a multi-plane image whose planes are not contiguous.
+     *  @param[in] width   Image width.
+     *  @param[in] height  Image height.
+     *  @param[in] type    TYPE_NV12 or TYPE_I420, packed types only use the first plane.
+     *  @param[in] planes  Head address of each plane: Y, UV for NV12 and Y, U, V for I420.
+     *  @param[in] strides Number of Bytes each row of each plane occupies.
+     */
+    EXPORT_API TSImgData(int32_t width, int32_t height, int32_t type,
+            uint8_t* const planes[3], const int32_t strides[3]);
+
     /**
      *  @brief Copy constructor.
      *  Implemented by deep copy command internally.
@@ -235,6 +268,18 @@ public:
      */
     EXPORT_API int32_t stride() const;
 
+    /**
+     *  @brief Get the head address of a plane, plane 0 is the same as data().
+     *  @retval nullptr The plane does not exist for this format.
+     */
+    EXPORT_API uint8_t* plane(int32_t index) const;
+
+    /**
+     *  @brief Get number of Bytes each row of a plane occupies.
+     *  @retval 0 The plane does not exist for this format.
+     */
+    EXPORT_API int32_t planeStride(int32_t index) const;
+
     /**
      *  @brief Get image channels.
      *  @retval 0 The TSImgData is empty
@@ -256,6 +301,7 @@ public:
 
     /**
      *  @brief Crop a sub region in an image.
+     *  For TYPE_NV12 and TYPE_I420 the top-left corner must be on even coordinates.
      *  @param[in] reg The interested region.
      *  @return The ROI image using shallow copy.
      */
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2012-2022
+ * All Rights Reserved by Thundercomm Technology Co., Ltd. and its affiliates.
+ * You may not use, copy, distribute, modify, transmit in any form this file
+ * except in compliance with THUNDERCOMM in writing by applicable law.
+ *
+ * @Description: Small fork-join worker pool used to split per-frame work.
+ * @version: 1.0
+ * @Author: Ricardo Lu<sheng.lu@thundercomm.com>
+ * @Date: 2026-10-17 14:03:12
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-17 14:03:12
+ */
+
+#include <algorithm>
+
+#include "TSThreadPool.h"
+
+namespace ts {
+
+TSThreadPool::TSThreadPool(int threads)
+{
+    resize(threads);
+}
+
+TSThreadPool::~TSThreadPool()
+{
+    stop();
+}
+
+void TSThreadPool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_wakeCond.notify_all();
+
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+    m_workers.clear();
+    m_quit = false;
+}
+
+void TSThreadPool::resize(int threads)
+{
+    threads = std::max(threads, 1);
+    if (threads == size()) {
+        return;
+    }
+
+    stop();
+    for (int i = 1; i < threads; i++) {
+        m_workers.emplace_back(&TSThreadPool::workerLoop, this);
+    }
+}
+
+int TSThreadPool::runTasks(Job* job)
+{
+    int done = 0;
+    for (int i = job->next++; i < job->tasks; i = job->next++) {
+        (*job->fn)(i);
+        done++;
+    }
+    return done;
+}
+
+void TSThreadPool::workerLoop()
+{
+    size_t generation = 0;
+    while (true) {
+        Job* job = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wakeCond.wait(lock, [&] {
+                return m_quit || (nullptr != m_job && generation != m_generation);
+            });
+            if (m_quit) {
+                return;
+            }
+            generation = m_generation;
+            job = m_job;
+            job->refs++;
+        }
+
+        int done = runTasks(job);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            job->finished += done;
+            job->refs--;
+        }
+        m_doneCond.notify_all();
+    }
+}
+
+void TSThreadPool::parallelFor(int n, const std::function<void(int)>& fn)
+{
+    if (n <= 0) {
+        return;
+    }
+
+    if (m_workers.empty() || n == 1) {
+        for (int i = 0; i < n; i++) {
+            fn(i);
+        }
+        return;
+    }
+
+    Job job;
+    job.fn = &fn;
+    job.tasks = n;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_job = &job;
+        m_generation++;
+    }
+    m_wakeCond.notify_all();
+
+    int done = runTasks(&job);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    job.finished += done;
+    m_doneCond.wait(lock, [&] { return job.finished == job.tasks && job.refs == 0; });
+    m_job = nullptr;
+}
+
+}   // namespace ts
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2012-2022
+ * All Rights Reserved by Thundercomm Technology Co., Ltd. and its affiliates.
+ * You may not use, copy, distribute, modify, transmit in any form this file
+ * except in compliance with THUNDERCOMM in writing by applicable law.
+ *
+ * @Description: Small fork-join worker pool used to split per-frame work.
+ * @version: 1.0
+ * @Author: Ricardo Lu<sheng.lu@thundercomm.com>
+ * @Date: 2026-10-17 14:03:12
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-17 14:03:12
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ts {
+
+/**
+ * @brief Fork-join pool: parallelFor() hands out task indexes to the workers
+ * and to the calling thread, and returns once every task is finished.
+ * A pool with a single thread runs everything on the caller.
+ */
+class TSThreadPool {
+public:
+    explicit TSThreadPool(int threads = 1);
+    ~TSThreadPool();
+
+    TSThreadPool(const TSThreadPool&) = delete;
+    TSThreadPool& operator=(const TSThreadPool&) = delete;
+
+    /**
+     * @brief Set the number of threads taking part in parallelFor(), caller included.
+     */
+    void resize(int threads);
+
+    int size() const {
+        return static_cast<int>(m_workers.size()) + 1;
+    }
+
+    /**
+     * @brief Run fn(i) for every i in [0, n) and wait for all of them.
+     * Must not be called concurrently on the same pool.
+     */
+    void parallelFor(int n, const std::function<void(int)>& fn);
+
+private:
+    // One parallelFor() call, lives on the caller stack until every worker left it.
+    struct Job {
+        const std::function<void(int)>* fn = nullptr;
+        int tasks = 0;
+        std::atomic<int> next{0};
+        int finished = 0;
+        int refs = 0;
+    };
+
+    void stop();
+    void workerLoop();
+    static int runTasks(Job* job);
+
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_wakeCond;
+    std::condition_variable m_doneCond;
+    bool m_quit = false;
+    size_t m_generation = 0;
+    Job* m_job = nullptr;
+};
+
+}   // namespace ts
@@ -11,6 +11,11 @@ int cvtTypeImgData2Buf(int format) {
         return RDC_32FC3;
     } else if (TYPE_BGR_U8 == format || TYPE_RGB_U8 == format) {
         return RDC_8UC3;
+    } else if (TYPE_BGRX_U8 == format || TYPE_RGBX_U8 == format) {
+        return RDC_8UC4;
+    } else if (TYPE_NV12 == format || TYPE_I420 == format) {
+        // Only the Y plane is described by the type, chroma planes are kept aside.
+        return RDC_8UC1;
     } else if (TYPE_C1_F32 == format) {
         return RDC_32FC1;
     } else if (TYPE_C1_U8 == format) {
@@ -128,6 +133,10 @@ ImgBuf::ImgBuf(cv::Size size, RDCImgType type, void* data, int stride) {
 
 ImgBuf::ImgBuf(const ImgBuf& img) {
     create(img.width_, img.height_, img.format_, NULL, img.stride_);
+    if (is_yuv420(format_)) {
+        img.copyPlanesTo(*this);
+        return;
+    }
     int buf_len = stride_ * height_ / pixel_len_;
     switch (pixel_len_) {
         case RDC_8U:
@@ -147,6 +156,7 @@ ImgBuf::~ImgBuf() {
 
 void ImgBuf::operator= (const ImgBuf &t) {
     this->size_ = t.size_;
+    this->format_ = t.format_;
     this->width_ = t.width_;
     this->height_ = t.height_;
     this->stride_ = t.stride_;
@@ -155,6 +165,9 @@ void ImgBuf::operator= (const ImgBuf &t) {
     this->type_ = t.type_;
     this->allocated = false;
     this->data_ = t.data_;
+    this->planes_[0] = t.planes_[0];
+    this->planes_[1] = t.planes_[1];
+    this->plane_stride_ = t.plane_stride_;
     return;
 }
 
@@ -185,14 +198,64 @@ void ImgBuf::create(int width, int height, int format, void *data, int stride) {
     stride_ = std::max(stride, width * channel_ * pixel_len_);
     size_ = cv::Size(width, height);
     data_ = tryAllocate(data);
+    setupPlanes();
     return;
 }
 
+void ImgBuf::setupPlanes() {
+    planes_[0] = planes_[1] = NULL;
+    plane_stride_ = 0;
+    if (!is_yuv420(format_) || NULL == data_) {
+        return;
+    }
+    // Default layout: chroma planes packed right after the Y plane.
+    uchar* chroma = reinterpret_cast<uchar*>(data_) + stride_ * height_;
+    if (TYPE_NV12 == format_) {
+        plane_stride_ = stride_;
+        planes_[0] = chroma;
+    } else {
+        plane_stride_ = (stride_ + 1) / 2;
+        planes_[0] = chroma;
+        planes_[1] = chroma + plane_stride_ * chroma_rows();
+    }
+}
+
+void ImgBuf::set_planes(void* plane1, void* plane2, int stride) {
+    planes_[0] = plane1;
+    planes_[1] = plane2;
+    plane_stride_ = stride;
+}
+
+int ImgBuf::chroma_len() const {
+    if (TYPE_NV12 == format_) {
+        return stride_ * chroma_rows();
+    } else if (TYPE_I420 == format_) {
+        return (stride_ + 1) / 2 * chroma_rows() * 2;
+    }
+    return 0;
+}
+
+void ImgBuf::copyPlanesTo(ImgBuf& dst) const {
+    copydata(reinterpret_cast<uchar*>(data_), reinterpret_cast<uchar*>(dst.data_),
+        stride_, dst.stride_, height_);
+    for (int i = 0; i < 2; i++) {
+        if (NULL != planes_[i] && NULL != dst.planes_[i]) {
+            copydata(reinterpret_cast<uchar*>(planes_[i]), reinterpret_cast<uchar*>(dst.planes_[i]),
+                plane_stride_, dst.plane_stride_, chroma_rows());
+        }
+    }
+}
+
 void ImgBuf::copyTo(ImgBuf &dst) const {
     if (this->empty()) {
         TS_ERROR_LOG("ERROR: The source ImgBuf is empty, and it cannot be copied!");
         return;
     }
+    if (is_yuv420(format_)) {
+        dst.create(this->width_, this->height_, this->format_, NULL, stride_);
+        copyPlanesTo(dst);
+        return;
+    }
 #if 1
     dst.create(this->width_, this->height_, this->type_, NULL, dst.stride());
     cv::Mat src_tmp, dst_tmp;
@@ -217,6 +280,10 @@ void ImgBuf::copyTo(ImgBuf &dst) const {
 }
 
 void ImgBuf::push_back(const ImgBuf& t) {
+    if (is_yuv420(this->format_) || is_yuv420(t.format_)) {
+        TS_ERROR_LOG("ERROR: Func \"ImgBuf::push_back\" does not support multi-plane images.");
+        return;
+    }
     if (this->empty()) {
         t.copyTo(*this);
         return;
@@ -275,7 +342,7 @@ void* ImgBuf::tryAllocate(void* p) {
             allocated = false;
             return data_;
         }
-        int buf_len = stride_ * height_ / pixel_len_;
+        int buf_len = (stride_ * height_ + chroma_len()) / pixel_len_;
         if (0 == buf_len) {
             allocated = false;
             return data_;
@@ -111,6 +111,32 @@ public:
      * */
     void* data() const { return data_; }
 
+    /** @brief Return the head pointer of plane i, plane 0 is data().
+     * Only TYPE_NV12(Y, UV) and TYPE_I420(Y, U, V) have more than one plane.
+     * */
+    void* plane(int i) const {
+        if (0 == i) return data_;
+        return (i < 3) ? planes_[i - 1] : nullptr;
+    }
+
+    /** @brief Return the number of bytes each row of plane i occupies.
+     * */
+    int plane_stride(int i) const {
+        if (0 == i) return stride_;
+        return (i < 3 && nullptr != planes_[i - 1]) ? plane_stride_ : 0;
+    }
+
+    /** @brief Point the chroma planes of a YUV 4:2:0 image at external memory.
+     * Used for views and buffers whose planes are not contiguous to the Y plane.
+     * */
+    void set_planes(void* plane1, void* plane2, int stride);
+
+    /** @brief Return true for YUV 4:2:0 formats stored as several planes.
+     * */
+    static bool is_yuv420(int format) {
+        return TYPE_NV12 == format || TYPE_I420 == format;
+    }
+
     /** @brief Return the byte length of element.
      * */
     int pixel_len() const { return pixel_len_; }
@@ -142,9 +168,15 @@ private:
     int pixel_len_ = 0;
     RDCImgType type_ = RDC_UNKNOWN;
     void* data_ = nullptr;
+    void* planes_[2] = {nullptr, nullptr};
+    int plane_stride_ = 0;
     bool allocated = false;
     void* tryAllocate(void* p);
     void tryDeallocate();
+    void setupPlanes();
+    int chroma_rows() const { return (height_ + 1) / 2; }
+    int chroma_len() const;
+    void copyPlanesTo(ImgBuf& dst) const;
 
     static int channels_of_type(RDCImgType type);
     static int pixellen_of_type(RDCImgType type);